@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+#include "AllocationProfiler.h"
+
+#include <stdint.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <execinfo.h>
+
+#include "MemoryPool.h"
+#include "Utility.h"
+
+
+#define SAMPLE_BUCKET_INDEX_WIDTH 12
+#define NUMBER_OF_SAMPLE_BUCKETS (1 << SAMPLE_BUCKET_INDEX_WIDTH)
+#define MAX_NUMBER_OF_FRAMES 64
+#define IDLE_BYTE_COUNTDOWN ((long)1 << 24)
+
+
+struct AllocationSample
+{
+    struct AllocationSample *nextSample;
+    const void *block;
+    size_t size;
+    int numberOfFrames;
+    void *frames[MAX_NUMBER_OF_FRAMES];
+};
+
+
+static long DrawByteCountdown(long);
+static int GetSampleBucketIndex(const void *);
+
+
+__thread long AllocationProfilerByteCountdown __attribute__((tls_model("initial-exec")));
+atomic_long AllocationProfilerNumberOfSamples;
+
+static __thread bool IsBusy __attribute__((tls_model("initial-exec")));
+static __thread uint64_t RandomState __attribute__((tls_model("initial-exec")));
+static atomic_long SamplingInterval;
+static long LastSamplingInterval;
+static pthread_mutex_t Mutex = PTHREAD_MUTEX_INITIALIZER;
+static bool SamplePoolIsInitialized;
+static struct MemoryPool SamplePool;
+static _Atomic(struct AllocationSample *) SampleBuckets[NUMBER_OF_SAMPLE_BUCKETS];
+
+
+void
+AllocationProfiler_Start(size_t samplingInterval)
+{
+    assert(samplingInterval >= 1 && samplingInterval <= LONG_MAX);
+    IsBusy = true;
+    pthread_mutex_lock(&Mutex);
+
+    if (!SamplePoolIsInitialized) {
+        MemoryPool_Initialize(&SamplePool, sizeof(struct AllocationSample));
+        SamplePoolIsInitialized = true;
+    }
+
+    /*
+     * The first backtrace may load the unwinder, which allocates memory.
+     */
+    void *frame;
+    backtrace(&frame, 1);
+    LastSamplingInterval = samplingInterval;
+    atomic_store_explicit(&SamplingInterval, samplingInterval, memory_order_relaxed);
+    pthread_mutex_unlock(&Mutex);
+    IsBusy = false;
+}
+
+
+void
+AllocationProfiler_Stop(void)
+{
+    atomic_store_explicit(&SamplingInterval, 0, memory_order_relaxed);
+}
+
+
+bool
+AllocationProfiler_Dump(FILE *stream)
+{
+    assert(stream != NULL);
+    IsBusy = true;
+    pthread_mutex_lock(&Mutex);
+    long numberOfSamples = 0;
+    size_t totalSize = 0;
+    int i;
+
+    for (i = 0; i < NUMBER_OF_SAMPLE_BUCKETS; ++i) {
+        const struct AllocationSample *sample;
+
+        for (sample = atomic_load_explicit(&SampleBuckets[i], memory_order_relaxed)
+             ; sample != NULL; sample = sample->nextSample) {
+            ++numberOfSamples;
+            totalSize += sample->size;
+        }
+    }
+
+    fprintf(stream, "heap profile: %ld: %zu [%ld: %zu] @ heap_v2/%ld\n", numberOfSamples
+            , totalSize, numberOfSamples, totalSize, LastSamplingInterval);
+
+    for (i = 0; i < NUMBER_OF_SAMPLE_BUCKETS; ++i) {
+        const struct AllocationSample *sample;
+
+        for (sample = atomic_load_explicit(&SampleBuckets[i], memory_order_relaxed)
+             ; sample != NULL; sample = sample->nextSample) {
+            fprintf(stream, "1: %zu [1: %zu] @", sample->size, sample->size);
+            int j;
+
+            for (j = 0; j < sample->numberOfFrames; ++j) {
+                fprintf(stream, " 0x%" PRIxPTR, (uintptr_t)sample->frames[j]);
+            }
+
+            fputc('\n', stream);
+        }
+    }
+
+    pthread_mutex_unlock(&Mutex);
+    /*
+     * pprof symbolizes the addresses with the memory map of the process.
+     */
+    fputs("\nMAPPED_LIBRARIES:\n", stream);
+    FILE *maps = fopen("/proc/self/maps", "r");
+
+    if (maps != NULL) {
+        char buffer[4096];
+        size_t n;
+
+        while ((n = fread(buffer, 1, sizeof buffer, maps)) >= 1) {
+            fwrite(buffer, 1, n, stream);
+        }
+
+        fclose(maps);
+    }
+
+    IsBusy = false;
+    return fflush(stream) == 0 && !ferror(stream);
+}
+
+
+void
+AllocationProfiler_SampleAllocation(const void *block, size_t size)
+{
+    long samplingInterval = atomic_load_explicit(&SamplingInterval, memory_order_relaxed);
+
+    if (samplingInterval == 0) {
+        AllocationProfilerByteCountdown = IDLE_BYTE_COUNTDOWN;
+        return;
+    }
+
+    if (RandomState == 0) {
+        /*
+         * The first countdown of a thread is drawn rather than taken as expired, so that the
+         * first allocation of each thread is not sampled.
+         */
+        RandomState = ((uint64_t)(uintptr_t)&RandomState ^ (uint64_t)time(NULL)) | 1;
+        AllocationProfilerByteCountdown = DrawByteCountdown(samplingInterval);
+        return;
+    }
+
+    AllocationProfilerByteCountdown = DrawByteCountdown(samplingInterval);
+
+    if (IsBusy || block == NULL) {
+        return;
+    }
+
+    IsBusy = true;
+    void *frames[MAX_NUMBER_OF_FRAMES + 1];
+    int numberOfFrames = backtrace(frames, LENGTH_OF(frames));
+    pthread_mutex_lock(&Mutex);
+    struct AllocationSample *sample = MemoryPool_AllocateBlock(&SamplePool);
+
+    if (sample != NULL) {
+        sample->block = block;
+        sample->size = size;
+        /*
+         * Drops the frame of this function, if backtrace(3) got any frame at all.
+         */
+        sample->numberOfFrames = numberOfFrames >= 1 ? numberOfFrames - 1 : 0;
+
+        if (sample->numberOfFrames >= 1) {
+            memcpy(sample->frames, frames + 1, sample->numberOfFrames * sizeof *frames);
+        }
+
+        _Atomic(struct AllocationSample *) *sampleBucket
+            = &SampleBuckets[GetSampleBucketIndex(block)];
+        sample->nextSample = atomic_load_explicit(sampleBucket, memory_order_relaxed);
+        atomic_store_explicit(sampleBucket, sample, memory_order_release);
+        atomic_fetch_add_explicit(&AllocationProfilerNumberOfSamples, 1, memory_order_release);
+    }
+
+    pthread_mutex_unlock(&Mutex);
+    IsBusy = false;
+}
+
+
+void
+AllocationProfiler_ForgetAllocation(const void *block)
+{
+    if (IsBusy) {
+        return;
+    }
+
+    _Atomic(struct AllocationSample *) *sampleBucket = &SampleBuckets[GetSampleBucketIndex(block)];
+
+    if (atomic_load_explicit(sampleBucket, memory_order_acquire) == NULL) {
+        return;
+    }
+
+    IsBusy = true;
+    pthread_mutex_lock(&Mutex);
+    struct AllocationSample *sample = atomic_load_explicit(sampleBucket, memory_order_relaxed);
+    struct AllocationSample *samplePrev = NULL;
+
+    while (sample != NULL && sample->block != block) {
+        samplePrev = sample;
+        sample = sample->nextSample;
+    }
+
+    if (sample != NULL) {
+        if (samplePrev == NULL) {
+            atomic_store_explicit(sampleBucket, sample->nextSample, memory_order_relaxed);
+        } else {
+            samplePrev->nextSample = sample->nextSample;
+        }
+
+        atomic_fetch_sub_explicit(&AllocationProfilerNumberOfSamples, 1, memory_order_relaxed);
+        MemoryPool_FreeBlock(&SamplePool, sample);
+    }
+
+    pthread_mutex_unlock(&Mutex);
+    IsBusy = false;
+}
+
+
+static long
+DrawByteCountdown(long samplingInterval)
+{
+    /*
+     * Exponentially distributed gaps make every byte equally likely to be sampled, whatever the
+     * allocation pattern is.
+     */
+    RandomState ^= RandomState << 13;
+    RandomState ^= RandomState >> 7;
+    RandomState ^= RandomState << 17;
+    double u = ((RandomState >> 11) + 1) * 0x1p-53;
+    return -log(u) * samplingInterval;
+}
+
+
+static int
+GetSampleBucketIndex(const void *block)
+{
+    return (uint64_t)((uintptr_t)block >> 4) * UINT64_C(0x9E3779B97F4A7C15)
+           >> (64 - SAMPLE_BUCKET_INDEX_WIDTH);
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+#pragma once
+
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdatomic.h>
+
+
+/*
+ * Allocations are only reported to the profiler when built with `ALLOCATION_PROFILER` defined.
+ * While started, about one allocation per sampling interval (in bytes) has its backtrace
+ * recorded, and the sample is kept until the block is freed. Profiles are dumped in the heap
+ * profile format of gperftools, which pprof reads.
+ */
+#ifdef ALLOCATION_PROFILER
+#define ALLOCATION_PROFILER_RECORD_ALLOCATION(block, size) \
+    AllocationProfiler_RecordAllocation(block, size)
+
+#define ALLOCATION_PROFILER_RECORD_FREE(block) \
+    AllocationProfiler_RecordFree(block)
+#else
+#define ALLOCATION_PROFILER_RECORD_ALLOCATION(block, size) \
+    ((void)0)
+
+#define ALLOCATION_PROFILER_RECORD_FREE(block) \
+    ((void)0)
+#endif
+
+
+extern __thread long AllocationProfilerByteCountdown __attribute__((tls_model("initial-exec")));
+extern atomic_long AllocationProfilerNumberOfSamples;
+
+
+static inline void AllocationProfiler_RecordAllocation(const void *, size_t);
+static inline void AllocationProfiler_RecordFree(const void *);
+
+void AllocationProfiler_Start(size_t);
+
+/*
+ * Stops taking new samples. Samples already taken are kept until their blocks are freed.
+ */
+void AllocationProfiler_Stop(void);
+
+/*
+ * Frees of sampled blocks wait for the dump to complete.
+ */
+bool AllocationProfiler_Dump(FILE *);
+
+void AllocationProfiler_SampleAllocation(const void *, size_t);
+void AllocationProfiler_ForgetAllocation(const void *);
+
+
+static inline void
+AllocationProfiler_RecordAllocation(const void *block, size_t size)
+{
+    if ((AllocationProfilerByteCountdown -= (long)size) < 0) {
+        AllocationProfiler_SampleAllocation(block, size);
+    }
+}
+
+
+static inline void
+AllocationProfiler_RecordFree(const void *block)
+{
+    if (atomic_load_explicit(&AllocationProfilerNumberOfSamples, memory_order_relaxed) != 0) {
+        AllocationProfiler_ForgetAllocation(block);
+    }
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+#include "Allocator.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+#define CACHE_LINE_SIZE 64
+
+
+static void *SystemAllocator_Allocate(struct Allocator *, size_t);
+static void *SystemAllocator_Reallocate(struct Allocator *, void *, size_t, size_t);
+static void SystemAllocator_Free(struct Allocator *, void *, size_t);
+static void *AlignedSystemAllocator_Allocate(struct Allocator *, size_t);
+static void *AlignedSystemAllocator_Reallocate(struct Allocator *, void *, size_t, size_t);
+
+
+struct Allocator SystemAllocator = {
+    .allocate = SystemAllocator_Allocate,
+    .reallocate = SystemAllocator_Reallocate,
+    .free = SystemAllocator_Free
+};
+
+struct Allocator AlignedSystemAllocator = {
+    .allocate = AlignedSystemAllocator_Allocate,
+    .reallocate = AlignedSystemAllocator_Reallocate,
+    .free = SystemAllocator_Free
+};
+
+
+static void *
+SystemAllocator_Allocate(struct Allocator *self, size_t size)
+{
+    (void)self;
+    return malloc(size);
+}
+
+
+static void *
+SystemAllocator_Reallocate(struct Allocator *self, void *block, size_t oldSize, size_t size)
+{
+    (void)self;
+    (void)oldSize;
+    return realloc(block, size);
+}
+
+
+static void
+SystemAllocator_Free(struct Allocator *self, void *block, size_t size)
+{
+    (void)self;
+    (void)size;
+    free(block);
+}
+
+
+static void *
+AlignedSystemAllocator_Allocate(struct Allocator *self, size_t size)
+{
+    (void)self;
+    void *block;
+
+    if (posix_memalign(&block, CACHE_LINE_SIZE, size) != 0) {
+        return NULL;
+    }
+
+    return block;
+}
+
+
+static void *
+AlignedSystemAllocator_Reallocate(struct Allocator *self, void *block, size_t oldSize
+                                  , size_t size)
+{
+    /*
+     * realloc(3) does not keep the alignment.
+     */
+    void *newBlock = AlignedSystemAllocator_Allocate(self, size);
+
+    if (newBlock == NULL) {
+        return NULL;
+    }
+
+    if (block != NULL) {
+        memcpy(newBlock, block, oldSize < size ? oldSize : size);
+        free(block);
+    }
+
+    return newBlock;
+}
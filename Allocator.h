@@ -0,0 +1,30 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+#pragma once
+
+
+#include <stddef.h>
+
+
+/*
+ * Sizes are passed back on reallocation and freeing, so that allocators need not record them.
+ * `reallocate` leaves the block untouched on failure. Stateful allocators embed this structure
+ * and recover themselves with `CONTAINER_OF`.
+ */
+struct Allocator
+{
+    void *(*allocate)(struct Allocator *, size_t);
+    void *(*reallocate)(struct Allocator *, void *, size_t, size_t);
+    void (*free)(struct Allocator *, void *, size_t);
+};
+
+
+extern struct Allocator SystemAllocator;
+
+/*
+ * Like `SystemAllocator`, but blocks are aligned to cache lines.
+ */
+extern struct Allocator AlignedSystemAllocator;
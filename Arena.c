@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+#include "Arena.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include "MemoryPool.h"
+#include "Utility.h"
+
+
+struct ArenaChunk
+{
+    struct ListItem listItem;
+    size_t size;
+};
+
+
+static bool Arena_IncreaseChunks(struct Arena *);
+static void *Arena_AllocateLargeBlock(struct Arena *, size_t, size_t);
+static void Arena_ReleaseChunk(struct Arena *, struct ArenaChunk *);
+
+static char *AlignAddress(char *, size_t);
+
+
+void
+Arena_Initialize(struct Arena *self)
+{
+    assert(self != NULL);
+    self->chunkProvider = &DefaultMemoryChunkProvider;
+    List_Initialize(&self->chunkListHead);
+    List_Initialize(&self->spareChunkListHead);
+    self->freeSpace = NULL;
+    self->freeSpaceEnd = NULL;
+}
+
+
+void
+Arena_Finalize(const struct Arena *self)
+{
+    assert(self != NULL);
+    struct ListItem *chunkListItem;
+    struct ListItem *temp;
+
+    FOR_EACH_LIST_ITEM_SAFE_REVERSE(chunkListItem, temp, &self->chunkListHead) {
+        struct ArenaChunk *chunk = CONTAINER_OF(chunkListItem, struct ArenaChunk, listItem);
+        self->chunkProvider->freeChunk(self->chunkProvider, chunk, chunk->size);
+    }
+
+    FOR_EACH_LIST_ITEM_SAFE_REVERSE(chunkListItem, temp, &self->spareChunkListHead) {
+        struct ArenaChunk *chunk = CONTAINER_OF(chunkListItem, struct ArenaChunk, listItem);
+        self->chunkProvider->freeChunk(self->chunkProvider, chunk, chunk->size);
+    }
+}
+
+
+void
+Arena_SetChunkProvider(struct Arena *self, struct MemoryChunkProvider *chunkProvider)
+{
+    assert(self != NULL);
+    assert(List_IsEmpty(&self->chunkListHead) && List_IsEmpty(&self->spareChunkListHead));
+    assert(chunkProvider != NULL);
+    self->chunkProvider = chunkProvider;
+}
+
+
+void
+Arena_Reset(struct Arena *self)
+{
+    assert(self != NULL);
+    struct ListItem *chunkListItem;
+    struct ListItem *temp;
+
+    FOR_EACH_LIST_ITEM_SAFE_REVERSE(chunkListItem, temp, &self->chunkListHead) {
+        Arena_ReleaseChunk(self, CONTAINER_OF(chunkListItem, struct ArenaChunk, listItem));
+    }
+
+    List_Initialize(&self->chunkListHead);
+    self->freeSpace = NULL;
+    self->freeSpaceEnd = NULL;
+}
+
+
+void
+Arena_ShrinkToFit(struct Arena *self)
+{
+    assert(self != NULL);
+    struct ListItem *chunkListItem;
+    struct ListItem *temp;
+
+    FOR_EACH_LIST_ITEM_SAFE_REVERSE(chunkListItem, temp, &self->spareChunkListHead) {
+        self->chunkProvider->freeChunk(self->chunkProvider, chunkListItem, MEMORY_CHUNK_SIZE);
+    }
+
+    List_Initialize(&self->spareChunkListHead);
+}
+
+
+void *
+Arena_Allocate(struct Arena *self, size_t size, size_t alignment)
+{
+    assert(self != NULL);
+    assert(alignment >= 1 && (alignment & (alignment - 1)) == 0);
+
+    if (alignment >= MEMORY_CHUNK_SIZE - sizeof(struct ArenaChunk)
+        || size > MEMORY_CHUNK_SIZE - sizeof(struct ArenaChunk) - alignment) {
+        return Arena_AllocateLargeBlock(self, size, alignment);
+    }
+
+    char *block = AlignAddress(self->freeSpace, alignment);
+
+    if (self->freeSpace == NULL || block > self->freeSpaceEnd
+        || size > (size_t)(self->freeSpaceEnd - block)) {
+        if (!Arena_IncreaseChunks(self)) {
+            return NULL;
+        }
+
+        block = AlignAddress(self->freeSpace, alignment);
+    }
+
+    self->freeSpace = block + size;
+    return block;
+}
+
+
+void
+Arena_Save(const struct Arena *self, struct ArenaSavepoint *savepoint)
+{
+    assert(self != NULL);
+    assert(savepoint != NULL);
+    savepoint->lastChunkListItem = List_GetBack(&self->chunkListHead);
+    savepoint->freeSpace = self->freeSpace;
+    savepoint->freeSpaceEnd = self->freeSpaceEnd;
+}
+
+
+void
+Arena_Rollback(struct Arena *self, const struct ArenaSavepoint *savepoint)
+{
+    assert(self != NULL);
+    assert(savepoint != NULL);
+
+    while (List_GetBack(&self->chunkListHead) != savepoint->lastChunkListItem) {
+        struct ListItem *chunkListItem = List_GetBack(&self->chunkListHead);
+        ListItem_Remove(chunkListItem);
+        Arena_ReleaseChunk(self, CONTAINER_OF(chunkListItem, struct ArenaChunk, listItem));
+    }
+
+    self->freeSpace = savepoint->freeSpace;
+    self->freeSpaceEnd = savepoint->freeSpaceEnd;
+}
+
+
+static bool
+Arena_IncreaseChunks(struct Arena *self)
+{
+    struct ArenaChunk *chunk;
+
+    if (List_IsEmpty(&self->spareChunkListHead)) {
+        chunk = self->chunkProvider->allocateChunk(self->chunkProvider, MEMORY_CHUNK_SIZE);
+
+        if (chunk == NULL) {
+            return false;
+        }
+
+        chunk->size = MEMORY_CHUNK_SIZE;
+    } else {
+        chunk = CONTAINER_OF(List_GetBack(&self->spareChunkListHead), struct ArenaChunk
+                             , listItem);
+        ListItem_Remove(&chunk->listItem);
+    }
+
+    List_InsertBack(&self->chunkListHead, &chunk->listItem);
+    self->freeSpace = (char *)(chunk + 1);
+    self->freeSpaceEnd = (char *)chunk + MEMORY_CHUNK_SIZE;
+    return true;
+}
+
+
+static void *
+Arena_AllocateLargeBlock(struct Arena *self, size_t size, size_t alignment)
+{
+    /*
+     * Blocks too large for a regular chunk get a dedicated one, which leaves the free space of
+     * the current chunk in place.
+     */
+    size_t chunkSize = MEMORY_CHUNK_SIZE;
+
+    while (chunkSize < sizeof(struct ArenaChunk) + alignment
+           || chunkSize - sizeof(struct ArenaChunk) - alignment < size) {
+        if (chunkSize > SIZE_MAX / 2) {
+            return NULL;
+        }
+
+        chunkSize *= 2;
+    }
+
+    struct ArenaChunk *chunk = self->chunkProvider->allocateChunk(self->chunkProvider, chunkSize);
+
+    if (chunk == NULL) {
+        return NULL;
+    }
+
+    chunk->size = chunkSize;
+    List_InsertBack(&self->chunkListHead, &chunk->listItem);
+    return AlignAddress((char *)(chunk + 1), alignment);
+}
+
+
+static void
+Arena_ReleaseChunk(struct Arena *self, struct ArenaChunk *chunk)
+{
+    if (chunk->size == MEMORY_CHUNK_SIZE) {
+        List_InsertBack(&self->spareChunkListHead, &chunk->listItem);
+    } else {
+        self->chunkProvider->freeChunk(self->chunkProvider, chunk, chunk->size);
+    }
+}
+
+
+static char *
+AlignAddress(char *address, size_t alignment)
+{
+    return (char *)(((uintptr_t)address + alignment - 1) & ~(uintptr_t)(alignment - 1));
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+#pragma once
+
+
+#include <stddef.h>
+
+#include "List.h"
+#include "MemoryChunkProvider.h"
+
+
+struct Arena
+{
+    struct MemoryChunkProvider *chunkProvider;
+    struct ListItem chunkListHead;
+    struct ListItem spareChunkListHead;
+    char *freeSpace;
+    char *freeSpaceEnd;
+};
+
+
+/*
+ * Marks the extent of an arena, which `Arena_Rollback` returns to, releasing whatever has been
+ * allocated since. Savepoints must be rolled back in LIFO order and are voided by `Arena_Reset`.
+ */
+struct ArenaSavepoint
+{
+    struct ListItem *lastChunkListItem;
+    char *freeSpace;
+    char *freeSpaceEnd;
+};
+
+
+void Arena_Initialize(struct Arena *);
+void Arena_Finalize(const struct Arena *);
+void Arena_SetChunkProvider(struct Arena *, struct MemoryChunkProvider *);
+void Arena_Reset(struct Arena *);
+void Arena_ShrinkToFit(struct Arena *);
+void *Arena_Allocate(struct Arena *, size_t, size_t);
+void Arena_Save(const struct Arena *, struct ArenaSavepoint *);
+void Arena_Rollback(struct Arena *, const struct ArenaSavepoint *);
@@ -0,0 +1,336 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+#include "ConcurrentMemoryPool.h"
+
+#include <stdlib.h>
+#include <assert.h>
+
+#include "Utility.h"
+
+
+#define MAGAZINE_CAPACITY 61
+
+
+struct Magazine
+{
+    struct ListItem listItem;
+    int numberOfBlocks;
+    void *blocks[MAGAZINE_CAPACITY];
+};
+
+
+struct MemoryPoolCache
+{
+    struct ListItem listItem;
+    struct ConcurrentMemoryPool *pool;
+    struct Magazine *loadedMagazine;
+    struct Magazine *previousMagazine;
+};
+
+
+static struct MemoryPoolCache *ConcurrentMemoryPool_GetCache(struct ConcurrentMemoryPool *);
+static struct Magazine *ConcurrentMemoryPool_ExchangeEmptyMagazine(struct ConcurrentMemoryPool *
+                                                                   , struct Magazine *);
+static struct Magazine *ConcurrentMemoryPool_ExchangeFullMagazine(struct ConcurrentMemoryPool *
+                                                                  , struct Magazine *);
+static void ConcurrentMemoryPool_ReturnMagazine(struct ConcurrentMemoryPool *, struct Magazine *);
+
+static void MemoryPoolCache_Destroy(void *);
+
+static struct Magazine *Magazine_Create(void);
+
+
+bool
+ConcurrentMemoryPool_Initialize(struct ConcurrentMemoryPool *self, size_t blockSize)
+{
+    assert(self != NULL);
+
+    if (pthread_key_create(&self->cacheKey, MemoryPoolCache_Destroy) != 0) {
+        return false;
+    }
+
+    pthread_mutex_init(&self->mutex, NULL);
+    MemoryPool_Initialize(&self->memoryPool, blockSize);
+    List_Initialize(&self->fullMagazineListHead);
+    List_Initialize(&self->emptyMagazineListHead);
+    List_Initialize(&self->cacheListHead);
+    return true;
+}
+
+
+void
+ConcurrentMemoryPool_Finalize(struct ConcurrentMemoryPool *self)
+{
+    assert(self != NULL);
+    pthread_key_delete(self->cacheKey);
+    struct ListItem *listItem;
+    struct ListItem *temp;
+
+    FOR_EACH_LIST_ITEM_SAFE_REVERSE(listItem, temp, &self->cacheListHead) {
+        struct MemoryPoolCache *cache = CONTAINER_OF(listItem, struct MemoryPoolCache, listItem);
+        free(cache->loadedMagazine);
+        free(cache->previousMagazine);
+        free(cache);
+    }
+
+    FOR_EACH_LIST_ITEM_SAFE_REVERSE(listItem, temp, &self->fullMagazineListHead) {
+        free(CONTAINER_OF(listItem, struct Magazine, listItem));
+    }
+
+    FOR_EACH_LIST_ITEM_SAFE_REVERSE(listItem, temp, &self->emptyMagazineListHead) {
+        free(CONTAINER_OF(listItem, struct Magazine, listItem));
+    }
+
+    MemoryPool_Finalize(&self->memoryPool);
+    pthread_mutex_destroy(&self->mutex);
+}
+
+
+void
+ConcurrentMemoryPool_ShrinkToFit(struct ConcurrentMemoryPool *self)
+{
+    assert(self != NULL);
+    pthread_mutex_lock(&self->mutex);
+    struct ListItem *listItem;
+    struct ListItem *temp;
+
+    FOR_EACH_LIST_ITEM_SAFE(listItem, temp, &self->fullMagazineListHead) {
+        struct Magazine *magazine = CONTAINER_OF(listItem, struct Magazine, listItem);
+        int i;
+
+        for (i = 0; i < magazine->numberOfBlocks; ++i) {
+            MemoryPool_FreeBlock(&self->memoryPool, magazine->blocks[i]);
+        }
+
+        free(magazine);
+    }
+
+    FOR_EACH_LIST_ITEM_SAFE(listItem, temp, &self->emptyMagazineListHead) {
+        free(CONTAINER_OF(listItem, struct Magazine, listItem));
+    }
+
+    List_Initialize(&self->fullMagazineListHead);
+    List_Initialize(&self->emptyMagazineListHead);
+    MemoryPool_ShrinkToFit(&self->memoryPool);
+    pthread_mutex_unlock(&self->mutex);
+}
+
+
+void *
+ConcurrentMemoryPool_AllocateBlock(struct ConcurrentMemoryPool *self)
+{
+    assert(self != NULL);
+    struct MemoryPoolCache *cache = ConcurrentMemoryPool_GetCache(self);
+
+    if (cache == NULL) {
+        pthread_mutex_lock(&self->mutex);
+        void *block = MemoryPool_AllocateBlock(&self->memoryPool);
+        pthread_mutex_unlock(&self->mutex);
+        return block;
+    }
+
+    if (cache->loadedMagazine->numberOfBlocks == 0) {
+        if (cache->previousMagazine->numberOfBlocks == 0) {
+            struct Magazine *magazine = ConcurrentMemoryPool_ExchangeEmptyMagazine
+                                        (self, cache->previousMagazine);
+
+            if (magazine == NULL) {
+                return NULL;
+            }
+
+            cache->previousMagazine = cache->loadedMagazine;
+            cache->loadedMagazine = magazine;
+        } else {
+            struct Magazine *magazine = cache->previousMagazine;
+            cache->previousMagazine = cache->loadedMagazine;
+            cache->loadedMagazine = magazine;
+        }
+    }
+
+    struct Magazine *magazine = cache->loadedMagazine;
+    return magazine->blocks[--magazine->numberOfBlocks];
+}
+
+
+void
+ConcurrentMemoryPool_FreeBlock(struct ConcurrentMemoryPool *self, void *block)
+{
+    assert(self != NULL);
+    assert(block != NULL);
+    struct MemoryPoolCache *cache = ConcurrentMemoryPool_GetCache(self);
+
+    if (cache == NULL) {
+        pthread_mutex_lock(&self->mutex);
+        MemoryPool_FreeBlock(&self->memoryPool, block);
+        pthread_mutex_unlock(&self->mutex);
+        return;
+    }
+
+    if (cache->loadedMagazine->numberOfBlocks == MAGAZINE_CAPACITY) {
+        if (cache->previousMagazine->numberOfBlocks == MAGAZINE_CAPACITY) {
+            struct Magazine *magazine = ConcurrentMemoryPool_ExchangeFullMagazine
+                                        (self, cache->previousMagazine);
+
+            if (magazine == NULL) {
+                pthread_mutex_lock(&self->mutex);
+                MemoryPool_FreeBlock(&self->memoryPool, block);
+                pthread_mutex_unlock(&self->mutex);
+                return;
+            }
+
+            cache->previousMagazine = cache->loadedMagazine;
+            cache->loadedMagazine = magazine;
+        } else {
+            struct Magazine *magazine = cache->previousMagazine;
+            cache->previousMagazine = cache->loadedMagazine;
+            cache->loadedMagazine = magazine;
+        }
+    }
+
+    struct Magazine *magazine = cache->loadedMagazine;
+    magazine->blocks[magazine->numberOfBlocks++] = block;
+}
+
+
+static struct MemoryPoolCache *
+ConcurrentMemoryPool_GetCache(struct ConcurrentMemoryPool *self)
+{
+    struct MemoryPoolCache *cache = pthread_getspecific(self->cacheKey);
+
+    if (cache != NULL) {
+        return cache;
+    }
+
+    cache = malloc(sizeof *cache);
+
+    if (cache == NULL) {
+        return NULL;
+    }
+
+    cache->pool = self;
+    cache->loadedMagazine = Magazine_Create();
+    cache->previousMagazine = Magazine_Create();
+
+    if (cache->loadedMagazine == NULL || cache->previousMagazine == NULL
+        || pthread_setspecific(self->cacheKey, cache) != 0) {
+        free(cache->loadedMagazine);
+        free(cache->previousMagazine);
+        free(cache);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&self->mutex);
+    List_InsertBack(&self->cacheListHead, &cache->listItem);
+    pthread_mutex_unlock(&self->mutex);
+    return cache;
+}
+
+
+static struct Magazine *
+ConcurrentMemoryPool_ExchangeEmptyMagazine(struct ConcurrentMemoryPool *self
+                                           , struct Magazine *emptyMagazine)
+{
+    pthread_mutex_lock(&self->mutex);
+    struct Magazine *magazine;
+
+    if (List_IsEmpty(&self->fullMagazineListHead)) {
+        magazine = emptyMagazine;
+
+        do {
+            void *block = MemoryPool_AllocateBlock(&self->memoryPool);
+
+            if (block == NULL) {
+                break;
+            }
+
+            magazine->blocks[magazine->numberOfBlocks++] = block;
+        } while (magazine->numberOfBlocks < MAGAZINE_CAPACITY / 2);
+
+        if (magazine->numberOfBlocks == 0) {
+            magazine = NULL;
+        }
+    } else {
+        magazine = CONTAINER_OF(List_GetBack(&self->fullMagazineListHead), struct Magazine
+                                , listItem);
+        ListItem_Remove(&magazine->listItem);
+        List_InsertBack(&self->emptyMagazineListHead, &emptyMagazine->listItem);
+    }
+
+    pthread_mutex_unlock(&self->mutex);
+    return magazine;
+}
+
+
+static struct Magazine *
+ConcurrentMemoryPool_ExchangeFullMagazine(struct ConcurrentMemoryPool *self
+                                          , struct Magazine *fullMagazine)
+{
+    pthread_mutex_lock(&self->mutex);
+    struct Magazine *magazine;
+
+    if (List_IsEmpty(&self->emptyMagazineListHead)) {
+        pthread_mutex_unlock(&self->mutex);
+        magazine = Magazine_Create();
+
+        if (magazine == NULL) {
+            return NULL;
+        }
+
+        pthread_mutex_lock(&self->mutex);
+    } else {
+        magazine = CONTAINER_OF(List_GetBack(&self->emptyMagazineListHead), struct Magazine
+                                , listItem);
+        ListItem_Remove(&magazine->listItem);
+    }
+
+    List_InsertBack(&self->fullMagazineListHead, &fullMagazine->listItem);
+    pthread_mutex_unlock(&self->mutex);
+    return magazine;
+}
+
+
+static void
+ConcurrentMemoryPool_ReturnMagazine(struct ConcurrentMemoryPool *self, struct Magazine *magazine)
+{
+    if (magazine->numberOfBlocks == MAGAZINE_CAPACITY) {
+        List_InsertBack(&self->fullMagazineListHead, &magazine->listItem);
+        return;
+    }
+
+    while (magazine->numberOfBlocks >= 1) {
+        MemoryPool_FreeBlock(&self->memoryPool, magazine->blocks[--magazine->numberOfBlocks]);
+    }
+
+    List_InsertBack(&self->emptyMagazineListHead, &magazine->listItem);
+}
+
+
+static void
+MemoryPoolCache_Destroy(void *cache1)
+{
+    struct MemoryPoolCache *cache = cache1;
+    struct ConcurrentMemoryPool *pool = cache->pool;
+    pthread_mutex_lock(&pool->mutex);
+    ConcurrentMemoryPool_ReturnMagazine(pool, cache->loadedMagazine);
+    ConcurrentMemoryPool_ReturnMagazine(pool, cache->previousMagazine);
+    ListItem_Remove(&cache->listItem);
+    pthread_mutex_unlock(&pool->mutex);
+    free(cache);
+}
+
+
+static struct Magazine *
+Magazine_Create(void)
+{
+    struct Magazine *magazine = malloc(sizeof *magazine);
+
+    if (magazine == NULL) {
+        return NULL;
+    }
+
+    magazine->numberOfBlocks = 0;
+    return magazine;
+}
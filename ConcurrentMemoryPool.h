@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+#pragma once
+
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "MemoryPool.h"
+#include "List.h"
+
+
+/*
+ * A thread-safe front-end of `struct MemoryPool`. Each thread caches free blocks in two
+ * magazines of its own, so that allocation and freeing take no lock until a magazine runs
+ * empty or full, at which point whole magazines are exchanged with a shared depot.
+ */
+struct ConcurrentMemoryPool
+{
+    pthread_mutex_t mutex;
+    pthread_key_t cacheKey;
+    struct MemoryPool memoryPool;
+    struct ListItem fullMagazineListHead;
+    struct ListItem emptyMagazineListHead;
+    struct ListItem cacheListHead;
+};
+
+
+bool ConcurrentMemoryPool_Initialize(struct ConcurrentMemoryPool *, size_t);
+void ConcurrentMemoryPool_Finalize(struct ConcurrentMemoryPool *);
+void ConcurrentMemoryPool_ShrinkToFit(struct ConcurrentMemoryPool *);
+void *ConcurrentMemoryPool_AllocateBlock(struct ConcurrentMemoryPool *);
+void ConcurrentMemoryPool_FreeBlock(struct ConcurrentMemoryPool *, void *);
@@ -5,27 +5,12 @@
 
 #include "Heap.h"
 
-#include <stdlib.h>
-
-
-#define HEAP_SEGMENT_LENGTH 256
-
-
-static bool Heap_IncreaseSegments(struct Heap *);
-static struct HeapNode **Heap_LocateSlot(const struct Heap *, int);
-static void Heap_SiftNodeUp(struct Heap *, struct HeapNode **, int (*)(const struct HeapNode *
-                                                                       , const struct HeapNode *));
-static void Heap_SiftNodeDown(struct Heap *, struct HeapNode **
-                              , int (*)(const struct HeapNode *, const struct HeapNode *));
-
 
 void
 Heap_Initialize(struct Heap *self)
 {
     assert(self != NULL);
-    Vector_Initialize(&self->segmentVector, sizeof(struct HeapNode **));
-    self->numberOfSegments = 0;
-    self->numberOfSlots = 0;
+    __HeapSegmentTable_Initialize(&self->segmentTable, sizeof(struct HeapNode *));
     self->numberOfNodes = 0;
 }
 
@@ -34,17 +19,24 @@ void
 Heap_Finalize(const struct Heap *self)
 {
     assert(self != NULL);
+    __HeapSegmentTable_Finalize(&self->segmentTable);
+}
 
-    if (self->numberOfSegments >= 1) {
-        struct HeapNode ***segments = Vector_GetElements(&self->segmentVector);
-        int i = self->numberOfSegments - 1;
 
-        do {
-            free(segments[i]);
-        } while (--i >= 0);
-    }
+void
+Heap_SetSegmentAllocator(struct Heap *self, struct Allocator *segmentAllocator)
+{
+    assert(self != NULL);
+    __HeapSegmentTable_SetSegmentAllocator(&self->segmentTable, segmentAllocator);
+}
+
 
-    Vector_Finalize(&self->segmentVector);
+void
+Heap_SetArity(struct Heap *self, int arity)
+{
+    assert(self != NULL);
+    assert(self->numberOfNodes == 0);
+    __HeapSegmentTable_SetArity(&self->segmentTable, arity);
 }
 
 
@@ -52,43 +44,64 @@ bool
 Heap_ShrinkToFit(struct Heap *self)
 {
     assert(self != NULL);
-    int numberOfSegments = (self->numberOfNodes + HEAP_SEGMENT_LENGTH - 1)
-                           / (unsigned int)HEAP_SEGMENT_LENGTH;
+    return __HeapSegmentTable_ShrinkToFit(&self->segmentTable, self->numberOfNodes);
+}
 
-    if (self->numberOfSegments > numberOfSegments) {
-        struct HeapNode ***segments = Vector_GetElements(&self->segmentVector);
-        int i = self->numberOfSegments - 1;
 
-        do {
-            free(segments[i]);
-        } while (--i >= numberOfSegments);
+bool
+Heap_InsertNode(struct Heap *self, struct HeapNode *node
+                , int (*nodeComparer)(const struct HeapNode *, const struct HeapNode *))
+{
+    assert(self != NULL);
+    assert(node != NULL);
+    assert(nodeComparer != NULL);
+    return __Heap_InsertNode(self, node, nodeComparer);
+}
 
-        self->numberOfSegments = numberOfSegments;
-        self->numberOfSlots = numberOfSegments * (unsigned int)HEAP_SEGMENT_LENGTH;
-    }
 
-    return Vector_SetLength(&self->segmentVector, numberOfSegments, false);
+bool
+Heap_InsertNodes(struct Heap *self, struct HeapNode *const *nodes, int numberOfNodes
+                 , int (*nodeComparer)(const struct HeapNode *, const struct HeapNode *))
+{
+    assert(self != NULL);
+    assert(nodes != NULL || numberOfNodes == 0);
+    assert(numberOfNodes >= 0);
+    assert(nodeComparer != NULL);
+    return __Heap_InsertNodes(self, nodes, numberOfNodes, nodeComparer);
 }
 
 
 bool
-Heap_InsertNode(struct Heap *self, struct HeapNode *node
-                , int (*nodeComparer)(const struct HeapNode *, const struct HeapNode *))
+Heap_Meld(struct Heap *self, struct Heap *other
+          , int (*nodeComparer)(const struct HeapNode *, const struct HeapNode *))
 {
     assert(self != NULL);
-    assert(node != NULL);
+    assert(other != NULL && other != self);
     assert(nodeComparer != NULL);
+    return __Heap_Meld(self, other, nodeComparer);
+}
 
-    if (self->numberOfNodes == self->numberOfSlots) {
-        if (!Heap_IncreaseSegments(self)) {
-            return false;
-        }
-    }
 
-    struct HeapNode **slot = Heap_LocateSlot(self, self->numberOfNodes);
-    (*slot = node)->slotNumber = self->numberOfNodes++;
-    Heap_SiftNodeUp(self, slot, nodeComparer);
-    return true;
+struct HeapNode *
+Heap_PopTop(struct Heap *self, int (*nodeComparer)(const struct HeapNode *
+                                                   , const struct HeapNode *))
+{
+    assert(self != NULL);
+    assert(self->numberOfNodes >= 1);
+    assert(nodeComparer != NULL);
+    return __Heap_PopTop(self, nodeComparer);
+}
+
+
+int
+Heap_PopTopK(struct Heap *self, struct HeapNode **nodes, int numberOfNodes
+             , int (*nodeComparer)(const struct HeapNode *, const struct HeapNode *))
+{
+    assert(self != NULL);
+    assert(nodes != NULL || numberOfNodes == 0);
+    assert(numberOfNodes >= 0);
+    assert(nodeComparer != NULL);
+    return __Heap_PopTopK(self, nodes, numberOfNodes, nodeComparer);
 }
 
 
@@ -99,15 +112,7 @@ Heap_AdjustNode(struct Heap *self, struct HeapNode *node
     assert(self != NULL);
     assert(node != NULL);
     assert(nodeComparer != NULL);
-
-    struct HeapNode **slot = Heap_LocateSlot(self, node->slotNumber);
-    Heap_SiftNodeUp(self, slot, nodeComparer);
-
-    if (*slot != node) {
-        return;
-    }
-
-    Heap_SiftNodeDown(self, slot, nodeComparer);
+    __Heap_AdjustNode(self, node, nodeComparer);
 }
 
 
@@ -118,112 +123,116 @@ Heap_RemoveNode(struct Heap *self, const struct HeapNode *node
     assert(self != NULL);
     assert(node != NULL);
     assert(nodeComparer != NULL);
+    __Heap_RemoveNode(self, node, nodeComparer);
+}
 
-    struct HeapNode **slot = Heap_LocateSlot(self, node->slotNumber);
-    (*slot = *Heap_LocateSlot(self, --self->numberOfNodes))->slotNumber = node->slotNumber;
-    int delta = nodeComparer(*slot, node);
-
-    if (delta == 0) {
-        return;
-    }
 
-    if (delta < 0) {
-        Heap_SiftNodeUp(self, slot, nodeComparer);
-    } else {
-        Heap_SiftNodeDown(self, slot, nodeComparer);
-    }
+void
+__HeapSegmentTable_Initialize(struct HeapSegmentTable *self, size_t slotSize)
+{
+    assert(self != NULL);
+    assert(slotSize >= 1 && HEAP_SEGMENT_SIZE % (HEAP_MAX_ARITY * slotSize) == 0);
+    self->segmentAllocator = &AlignedSystemAllocator;
+    SMALL_VECTOR_INITIALIZE(&self->segmentVector);
+    self->segmentLength = HEAP_SEGMENT_SIZE / slotSize;
+    self->arityShift = 1;
+    self->numberOfSegments = 0;
+    self->numberOfSlots = 0;
 }
 
 
-static bool
-Heap_IncreaseSegments(struct Heap *self)
+void
+__HeapSegmentTable_Finalize(const struct HeapSegmentTable *self)
 {
-    if (self->numberOfSegments == Vector_GetLength(&self->segmentVector)) {
-        if (!Vector_SetLength(&self->segmentVector, self->numberOfSegments + 1, false)) {
-            return false;
-        }
-    }
+    assert(self != NULL);
 
-    struct HeapNode **segment = malloc(HEAP_SEGMENT_LENGTH * sizeof *segment);
+    if (self->numberOfSegments >= 1) {
+        void **segments = Vector_GetElements(&self->segmentVector.vector);
+        int i = self->numberOfSegments - 1;
 
-    if (segment == NULL) {
-        return false;
+        do {
+            self->segmentAllocator->free(self->segmentAllocator, segments[i], HEAP_SEGMENT_SIZE);
+        } while (--i >= 0);
     }
 
-    struct HeapNode ***segments = Vector_GetElements(&self->segmentVector);
-    segments[self->numberOfSegments++] = segment;
-    self->numberOfSlots += HEAP_SEGMENT_LENGTH;
-    return true;
+    Vector_Finalize(&self->segmentVector.vector);
+}
+
+
+void
+__HeapSegmentTable_SetSegmentAllocator(struct HeapSegmentTable *self
+                                       , struct Allocator *segmentAllocator)
+{
+    assert(self != NULL);
+    assert(self->numberOfSegments == 0);
+    assert(segmentAllocator != NULL);
+    self->segmentAllocator = segmentAllocator;
 }
 
 
-static struct HeapNode **
-Heap_LocateSlot(const struct Heap *self, int slotNumber)
+void
+__HeapSegmentTable_SetArity(struct HeapSegmentTable *self, int arity)
 {
-    struct HeapNode ***segments = Vector_GetElements(&self->segmentVector);
-    return &segments[slotNumber / (unsigned int)HEAP_SEGMENT_LENGTH]
-                    [slotNumber % (unsigned int)HEAP_SEGMENT_LENGTH];
+    assert(self != NULL);
+    assert(arity == 2 || arity == 4 || arity == 8);
+    self->arityShift = __builtin_ctz(arity);
 }
 
 
-static void
-Heap_SiftNodeUp(struct Heap *self, struct HeapNode **slotX
-                , int (*nodeComparer)(const struct HeapNode *, const struct HeapNode *))
+bool
+__HeapSegmentTable_ShrinkToFit(struct HeapSegmentTable *self, int numberOfNodes)
 {
-    struct HeapNode *node = *slotX;
-    int x = node->slotNumber;
+    assert(self != NULL);
+    assert(numberOfNodes >= 0);
+    int numberOfSegments = 0;
 
-    while (x >= 1) {
-        int y = (x - 1) / 2u;
-        struct HeapNode **slotY = Heap_LocateSlot(self, y);
+    if (numberOfNodes >= 1) {
+        numberOfSegments = (numberOfNodes + (1 << self->arityShift) - 1 + self->segmentLength - 1)
+                           / self->segmentLength;
+    }
 
-        if (nodeComparer(node, *slotY) >= 0) {
-            break;
-        }
+    if (self->numberOfSegments > numberOfSegments) {
+        void **segments = Vector_GetElements(&self->segmentVector.vector);
+        int i = self->numberOfSegments - 1;
 
-        (*slotX = *slotY)->slotNumber = x;
-        slotX = slotY;
-        x = y;
+        do {
+            self->segmentAllocator->free(self->segmentAllocator, segments[i], HEAP_SEGMENT_SIZE);
+        } while (--i >= numberOfSegments);
+
+        self->numberOfSegments = numberOfSegments;
+        self->numberOfSlots = numberOfSegments * self->segmentLength;
     }
 
-    (*slotX = node)->slotNumber = x;
+    return Vector_SetLength(&self->segmentVector.vector, numberOfSegments, false);
 }
 
 
-static void
-Heap_SiftNodeDown(struct Heap *self, struct HeapNode **slotX
-                  , int (*nodeComparer)(const struct HeapNode *, const struct HeapNode *))
+bool
+__HeapSegmentTable_IncreaseSegments(struct HeapSegmentTable *self, int numberOfSegments)
 {
-    struct HeapNode *node = *slotX;
-    int x = node->slotNumber;
-
-    for (;;) {
-        int y = 2u * x + 1;
+    assert(self != NULL);
+    assert(numberOfSegments >= 1);
+    int newNumberOfSegments = self->numberOfSegments + numberOfSegments;
 
-        if (y >= self->numberOfNodes) {
-            break;
+    if (newNumberOfSegments > Vector_GetLength(&self->segmentVector.vector)) {
+        if (!Vector_SetLength(&self->segmentVector.vector, newNumberOfSegments, false)) {
+            return false;
         }
+    }
 
-        struct HeapNode **slotY = Heap_LocateSlot(self, y);
-        int z = y + 1;
-
-        if (z < self->numberOfNodes) {
-            struct HeapNode **slotZ = Heap_LocateSlot(self, z);
+    void **segments = Vector_GetElements(&self->segmentVector.vector);
 
-            if (nodeComparer(*slotZ, *slotY) < 0) {
-                slotY = slotZ;
-                y = z;
-            }
-        }
+    do {
+        void *segment = self->segmentAllocator->allocate(self->segmentAllocator
+                                                         , HEAP_SEGMENT_SIZE);
 
-        if (nodeComparer(node, *slotY) <= 0) {
-            break;
+        if (segment == NULL) {
+            return false;
         }
 
-        (*slotX = *slotY)->slotNumber = x;
-        slotX = slotY;
-        x = y;
-    }
+        segments[self->numberOfSegments++] = segment;
+        self->numberOfSlots += self->segmentLength;
+    } while (self->numberOfSegments < newNumberOfSegments);
 
-    (*slotX = node)->slotNumber = x;
+    return true;
 }
@@ -11,13 +11,116 @@
 #include <assert.h>
 
 #include "Vector.h"
+#include "Allocator.h"
+#include "Utility.h"
 
 
-struct Heap
+#define HEAP_SEGMENT_LENGTH 256
+#define HEAP_SEGMENT_SIZE (HEAP_SEGMENT_LENGTH * sizeof(struct HeapNode *))
+#define HEAP_NUMBER_OF_INLINE_SEGMENTS 2
+#define HEAP_MAX_ARITY 8
+
+
+/*
+ * Defines counterparts of the `Heap` functions for heaps of `type` linked through `field`, with
+ * `comparer` (taking two `const type *`) inlined.
+ */
+#define DEFINE_HEAP(name, type, field, comparer)                                             \
+    static inline int                                                                        \
+    name##_CompareNodes(const struct HeapNode *node1, const struct HeapNode *node2)          \
+    {                                                                                        \
+        return comparer(CONTAINER_OF(node1, type, field), CONTAINER_OF(node2, type, field)); \
+    }                                                                                        \
+                                                                                             \
+    static inline bool                                                                       \
+    name##_InsertNode(struct Heap *heap, type *object)                                       \
+    {                                                                                        \
+        assert(heap != NULL);                                                                \
+        assert(object != NULL);                                                              \
+        return __Heap_InsertNode(heap, &object->field, name##_CompareNodes);                 \
+    }                                                                                        \
+                                                                                             \
+    static inline bool                                                                       \
+    name##_InsertNodes(struct Heap *heap, struct HeapNode *const *nodes, int numberOfNodes)  \
+    {                                                                                        \
+        assert(heap != NULL);                                                                \
+        assert(nodes != NULL || numberOfNodes == 0);                                         \
+        assert(numberOfNodes >= 0);                                                          \
+        return __Heap_InsertNodes(heap, nodes, numberOfNodes, name##_CompareNodes);          \
+    }                                                                                        \
+                                                                                             \
+    static inline bool                                                                       \
+    name##_Meld(struct Heap *heap, struct Heap *other)                                       \
+    {                                                                                        \
+        assert(heap != NULL);                                                                \
+        assert(other != NULL && other != heap);                                              \
+        return __Heap_Meld(heap, other, name##_CompareNodes);                                \
+    }                                                                                        \
+                                                                                             \
+    static inline type *                                                                     \
+    name##_PopTop(struct Heap *heap)                                                         \
+    {                                                                                        \
+        assert(heap != NULL);                                                                \
+        assert(heap->numberOfNodes >= 1);                                                    \
+        return CONTAINER_OF(__Heap_PopTop(heap, name##_CompareNodes), type, field);          \
+    }                                                                                        \
+                                                                                             \
+    static inline int                                                                        \
+    name##_PopTopK(struct Heap *heap, struct HeapNode **nodes, int numberOfNodes)            \
+    {                                                                                        \
+        assert(heap != NULL);                                                                \
+        assert(nodes != NULL || numberOfNodes == 0);                                         \
+        assert(numberOfNodes >= 0);                                                          \
+        return __Heap_PopTopK(heap, nodes, numberOfNodes, name##_CompareNodes);              \
+    }                                                                                        \
+                                                                                             \
+    static inline void                                                                       \
+    name##_AdjustNode(struct Heap *heap, type *object)                                       \
+    {                                                                                        \
+        assert(heap != NULL);                                                                \
+        assert(object != NULL);                                                              \
+        __Heap_AdjustNode(heap, &object->field, name##_CompareNodes);                        \
+    }                                                                                        \
+                                                                                             \
+    static inline void                                                                       \
+    name##_RemoveNode(struct Heap *heap, const type *object)                                 \
+    {                                                                                        \
+        assert(heap != NULL);                                                                \
+        assert(object != NULL);                                                              \
+        __Heap_RemoveNode(heap, &object->field, name##_CompareNodes);                        \
+    }                                                                                        \
+                                                                                             \
+    static inline type *                                                                     \
+    name##_GetTop(const struct Heap *heap)                                                   \
+    {                                                                                        \
+        struct HeapNode *node = Heap_GetTop(heap);                                           \
+        return node == NULL ? NULL : CONTAINER_OF(node, type, field);                        \
+    }
+
+
+/*
+ * The segments of slots of a heap, shared by `struct Heap` and `struct KeyedHeap`, which differ
+ * in the size of their slots.
+ *
+ * Slots are laid out `arity - 1` places past the start of the first segment, so the children of
+ * a node, which are adjacent, start on a multiple of the arity. Segment lengths are multiples of
+ * `HEAP_MAX_ARITY`, hence with cache-line-aligned segments a group of children never crosses a
+ * cache line, nor a segment boundary.
+ */
+struct HeapSegmentTable
 {
-    struct Vector segmentVector;
+    struct Allocator *segmentAllocator;
+    SMALL_VECTOR(void *, HEAP_NUMBER_OF_INLINE_SEGMENTS) segmentVector;
+    int segmentLength;
+    int arityShift;
     int numberOfSegments;
     int numberOfSlots;
+};
+
+
+struct Heap
+{
+    struct HeapSegmentTable segmentTable;
     int numberOfNodes;
 };
 
@@ -32,14 +135,88 @@ static inline struct HeapNode *Heap_GetTop(const struct Heap *);
 
 void Heap_Initialize(struct Heap *);
 void Heap_Finalize(const struct Heap *);
+
+/*
+ * Segments are all `HEAP_SEGMENT_SIZE` bytes, which makes them a fit for a `MemoryPoolAllocator`.
+ * They come from `AlignedSystemAllocator` by default.
+ */
+void Heap_SetSegmentAllocator(struct Heap *, struct Allocator *);
+
+/*
+ * The arity is 2 (the default), 4 or 8. A higher arity halves or thirds the depth of the heap and
+ * lets sift-downs pick the least child out of one cache line, at the cost of more comparisons.
+ * It pays off once the heap outgrows the cache (see bench/HeapBenchmark.c).
+ */
+void Heap_SetArity(struct Heap *, int);
 bool Heap_ShrinkToFit(struct Heap *);
 bool Heap_InsertNode(struct Heap *, struct HeapNode *, int (*)(const struct HeapNode *
                                                                , const struct HeapNode *));
+
+/*
+ * Either inserts the nodes one by one or, when they outnumber the nodes already in the heap,
+ * appends them all and rebuilds the heap bottom-up, in linear time. All segments needed are
+ * allocated first, so on failure no node is inserted.
+ */
+bool Heap_InsertNodes(struct Heap *, struct HeapNode *const *, int
+                      , int (*)(const struct HeapNode *, const struct HeapNode *));
+
+/*
+ * Moves all nodes of the other heap into the heap, in linear time when they outnumber the nodes
+ * already in it.
+ */
+bool Heap_Meld(struct Heap *, struct Heap *, int (*)(const struct HeapNode *
+                                                     , const struct HeapNode *));
+
+/*
+ * Removes the top, which the heap must have, and returns it. The hole left by the top is moved
+ * down without comparing the children against the node filling it, making fewer comparisons than
+ * `Heap_RemoveNode`.
+ */
+struct HeapNode *Heap_PopTop(struct Heap *, int (*)(const struct HeapNode *
+                                                    , const struct HeapNode *));
+
+/*
+ * Pops up to the given number of nodes, in order, and returns how many are popped.
+ */
+int Heap_PopTopK(struct Heap *, struct HeapNode **, int, int (*)(const struct HeapNode *
+                                                                 , const struct HeapNode *));
 void Heap_AdjustNode(struct Heap *, struct HeapNode *, int (*)(const struct HeapNode *
                                                                , const struct HeapNode *));
 void Heap_RemoveNode(struct Heap *, const struct HeapNode *, int (*)(const struct HeapNode *
                                                                      , const struct HeapNode *));
 
+void __HeapSegmentTable_Initialize(struct HeapSegmentTable *, size_t);
+void __HeapSegmentTable_Finalize(const struct HeapSegmentTable *);
+void __HeapSegmentTable_SetSegmentAllocator(struct HeapSegmentTable *, struct Allocator *);
+void __HeapSegmentTable_SetArity(struct HeapSegmentTable *, int);
+bool __HeapSegmentTable_ShrinkToFit(struct HeapSegmentTable *, int);
+bool __HeapSegmentTable_IncreaseSegments(struct HeapSegmentTable *, int);
+
+static inline int __Heap_GetSlotOffset(const struct Heap *);
+static inline struct HeapNode **__Heap_LocateSlot(const struct Heap *, int);
+static inline bool __Heap_InsertNode(struct Heap *, struct HeapNode *
+                                     , int (*)(const struct HeapNode *, const struct HeapNode *));
+static inline bool __Heap_InsertNodes(struct Heap *, struct HeapNode *const *, int
+                                      , int (*)(const struct HeapNode *, const struct HeapNode *));
+static inline bool __Heap_Meld(struct Heap *, struct Heap *
+                               , int (*)(const struct HeapNode *, const struct HeapNode *));
+static inline struct HeapNode *__Heap_PopTop(struct Heap *, int (*)(const struct HeapNode *
+                                                                    , const struct HeapNode *));
+static inline int __Heap_PopTopK(struct Heap *, struct HeapNode **, int
+                                 , int (*)(const struct HeapNode *, const struct HeapNode *));
+static inline bool __Heap_ReserveNodes(struct Heap *, int);
+static inline void __Heap_FixNodes(struct Heap *, int, int (*)(const struct HeapNode *
+                                                               , const struct HeapNode *));
+static inline void __Heap_AdjustNode(struct Heap *, struct HeapNode *
+                                     , int (*)(const struct HeapNode *, const struct HeapNode *));
+static inline void __Heap_RemoveNode(struct Heap *, const struct HeapNode *
+                                     , int (*)(const struct HeapNode *, const struct HeapNode *));
+static inline void __Heap_SiftNodeUp(struct Heap *, struct HeapNode **
+                                     , int (*)(const struct HeapNode *, const struct HeapNode *));
+static inline void __Heap_SiftNodeDown(struct Heap *, struct HeapNode **
+                                       , int (*)(const struct HeapNode *
+                                                 , const struct HeapNode *));
+
 
 static inline struct HeapNode *
 Heap_GetTop(const struct Heap *self)
@@ -50,6 +227,298 @@ Heap_GetTop(const struct Heap *self)
         return NULL;
     }
 
-    struct HeapNode ***segments = Vector_GetElements(&self->segmentVector);
-    return segments[0][0];
+    struct HeapNode ***segments = Vector_GetElements(&self->segmentTable.segmentVector.vector);
+    return segments[0][__Heap_GetSlotOffset(self)];
+}
+
+
+static inline int
+__Heap_GetSlotOffset(const struct Heap *self)
+{
+    return (1 << self->segmentTable.arityShift) - 1;
+}
+
+
+static inline struct HeapNode **
+__Heap_LocateSlot(const struct Heap *self, int slotNumber)
+{
+    struct HeapNode ***segments = Vector_GetElements(&self->segmentTable.segmentVector.vector);
+    unsigned int slotIndex = slotNumber + __Heap_GetSlotOffset(self);
+    return &segments[slotIndex / HEAP_SEGMENT_LENGTH][slotIndex % HEAP_SEGMENT_LENGTH];
+}
+
+
+static inline __attribute__((always_inline)) bool
+__Heap_InsertNode(struct Heap *self, struct HeapNode *node
+                  , int (*nodeComparer)(const struct HeapNode *, const struct HeapNode *))
+{
+    if (self->numberOfNodes + __Heap_GetSlotOffset(self) >= self->segmentTable.numberOfSlots) {
+        if (!__HeapSegmentTable_IncreaseSegments(&self->segmentTable, 1)) {
+            return false;
+        }
+    }
+
+    struct HeapNode **slot = __Heap_LocateSlot(self, self->numberOfNodes);
+    (*slot = node)->slotNumber = self->numberOfNodes++;
+    __Heap_SiftNodeUp(self, slot, nodeComparer);
+    return true;
+}
+
+
+static inline __attribute__((always_inline)) bool
+__Heap_InsertNodes(struct Heap *self, struct HeapNode *const *nodes, int numberOfNodes
+                   , int (*nodeComparer)(const struct HeapNode *, const struct HeapNode *))
+{
+    if (!__Heap_ReserveNodes(self, numberOfNodes)) {
+        return false;
+    }
+
+    int firstSlotNumber = self->numberOfNodes;
+    int i;
+
+    for (i = 0; i < numberOfNodes; ++i) {
+        struct HeapNode **slot = __Heap_LocateSlot(self, self->numberOfNodes);
+        (*slot = nodes[i])->slotNumber = self->numberOfNodes++;
+    }
+
+    __Heap_FixNodes(self, firstSlotNumber, nodeComparer);
+    return true;
+}
+
+
+static inline __attribute__((always_inline)) bool
+__Heap_Meld(struct Heap *self, struct Heap *other
+            , int (*nodeComparer)(const struct HeapNode *, const struct HeapNode *))
+{
+    if (!__Heap_ReserveNodes(self, other->numberOfNodes)) {
+        return false;
+    }
+
+    int firstSlotNumber = self->numberOfNodes;
+    int i;
+
+    for (i = 0; i < other->numberOfNodes; ++i) {
+        struct HeapNode **slot = __Heap_LocateSlot(self, self->numberOfNodes);
+        (*slot = *__Heap_LocateSlot(other, i))->slotNumber = self->numberOfNodes++;
+    }
+
+    other->numberOfNodes = 0;
+    __Heap_FixNodes(self, firstSlotNumber, nodeComparer);
+    return true;
+}
+
+
+static inline __attribute__((always_inline)) struct HeapNode *
+__Heap_PopTop(struct Heap *self
+              , int (*nodeComparer)(const struct HeapNode *, const struct HeapNode *))
+{
+    struct HeapNode **slotX = __Heap_LocateSlot(self, 0);
+    struct HeapNode *top = *slotX;
+    struct HeapNode *last = *__Heap_LocateSlot(self, --self->numberOfNodes);
+
+    if (last == top) {
+        return top;
+    }
+
+    /*
+     * The hole left by the top is moved down to a leaf along the path of the least children,
+     * without comparing them against the last node, which is then put in the hole and sifted
+     * up, usually by few levels.
+     */
+    int x = 0;
+
+    for (;;) {
+        int y = ((unsigned int)x << self->segmentTable.arityShift) + 1;
+
+        if (y >= self->numberOfNodes) {
+            break;
+        }
+
+        struct HeapNode **childSlots = __Heap_LocateSlot(self, y);
+        int numberOfChildren = 1 << self->segmentTable.arityShift;
+
+        if (numberOfChildren > self->numberOfNodes - y) {
+            numberOfChildren = self->numberOfNodes - y;
+        }
+
+        int i = 0;
+        int j;
+
+        for (j = 1; j < numberOfChildren; ++j) {
+            if (nodeComparer(childSlots[j], childSlots[i]) < 0) {
+                i = j;
+            }
+        }
+
+        (*slotX = childSlots[i])->slotNumber = x;
+        slotX = &childSlots[i];
+        x = y + i;
+    }
+
+    (*slotX = last)->slotNumber = x;
+    __Heap_SiftNodeUp(self, slotX, nodeComparer);
+    return top;
+}
+
+
+static inline __attribute__((always_inline)) int
+__Heap_PopTopK(struct Heap *self, struct HeapNode **nodes, int numberOfNodes
+               , int (*nodeComparer)(const struct HeapNode *, const struct HeapNode *))
+{
+    if (numberOfNodes > self->numberOfNodes) {
+        numberOfNodes = self->numberOfNodes;
+    }
+
+    int i;
+
+    for (i = 0; i < numberOfNodes; ++i) {
+        nodes[i] = __Heap_PopTop(self, nodeComparer);
+    }
+
+    return numberOfNodes;
+}
+
+
+static inline bool
+__Heap_ReserveNodes(struct Heap *self, int numberOfNodes)
+{
+    int numberOfSlots = self->numberOfNodes + numberOfNodes + __Heap_GetSlotOffset(self);
+
+    if (numberOfSlots <= self->segmentTable.numberOfSlots) {
+        return true;
+    }
+
+    return __HeapSegmentTable_IncreaseSegments(&self->segmentTable
+                                               , (numberOfSlots - self->segmentTable.numberOfSlots
+                                                  + HEAP_SEGMENT_LENGTH - 1) / HEAP_SEGMENT_LENGTH);
+}
+
+
+static inline __attribute__((always_inline)) void
+__Heap_FixNodes(struct Heap *self, int firstSlotNumber
+                , int (*nodeComparer)(const struct HeapNode *, const struct HeapNode *))
+{
+    int i;
+
+    /*
+     * Nodes from the given slot on are out of order. When they outnumber the others, the heap is
+     * rebuilt with Floyd's method, which sifts down every parent, from the last one to the root.
+     */
+    if (self->numberOfNodes - firstSlotNumber < firstSlotNumber) {
+        for (i = firstSlotNumber; i < self->numberOfNodes; ++i) {
+            __Heap_SiftNodeUp(self, __Heap_LocateSlot(self, i), nodeComparer);
+        }
+    } else if (self->numberOfNodes >= 2) {
+        for (i = (self->numberOfNodes - 2u) >> self->segmentTable.arityShift; i >= 0; --i) {
+            __Heap_SiftNodeDown(self, __Heap_LocateSlot(self, i), nodeComparer);
+        }
+    }
+}
+
+
+static inline __attribute__((always_inline)) void
+__Heap_AdjustNode(struct Heap *self, struct HeapNode *node
+                  , int (*nodeComparer)(const struct HeapNode *, const struct HeapNode *))
+{
+    struct HeapNode **slot = __Heap_LocateSlot(self, node->slotNumber);
+    __Heap_SiftNodeUp(self, slot, nodeComparer);
+
+    if (*slot != node) {
+        return;
+    }
+
+    __Heap_SiftNodeDown(self, slot, nodeComparer);
+}
+
+
+static inline __attribute__((always_inline)) void
+__Heap_RemoveNode(struct Heap *self, const struct HeapNode *node
+                  , int (*nodeComparer)(const struct HeapNode *, const struct HeapNode *))
+{
+    struct HeapNode **slot = __Heap_LocateSlot(self, node->slotNumber);
+    (*slot = *__Heap_LocateSlot(self, --self->numberOfNodes))->slotNumber = node->slotNumber;
+    int delta = nodeComparer(*slot, node);
+
+    if (delta == 0) {
+        return;
+    }
+
+    if (delta < 0) {
+        __Heap_SiftNodeUp(self, slot, nodeComparer);
+    } else {
+        __Heap_SiftNodeDown(self, slot, nodeComparer);
+    }
+}
+
+
+static inline __attribute__((always_inline)) void
+__Heap_SiftNodeUp(struct Heap *self, struct HeapNode **slotX
+                  , int (*nodeComparer)(const struct HeapNode *, const struct HeapNode *))
+{
+    struct HeapNode *node = *slotX;
+    int x = node->slotNumber;
+
+    while (x >= 1) {
+        int y = (x - 1u) >> self->segmentTable.arityShift;
+        struct HeapNode **slotY = __Heap_LocateSlot(self, y);
+
+        if (nodeComparer(node, *slotY) >= 0) {
+            break;
+        }
+
+        (*slotX = *slotY)->slotNumber = x;
+        slotX = slotY;
+        x = y;
+    }
+
+    (*slotX = node)->slotNumber = x;
+}
+
+
+static inline __attribute__((always_inline)) void
+__Heap_SiftNodeDown(struct Heap *self, struct HeapNode **slotX
+                    , int (*nodeComparer)(const struct HeapNode *, const struct HeapNode *))
+{
+    struct HeapNode *node = *slotX;
+    int x = node->slotNumber;
+
+    for (;;) {
+        int y = ((unsigned int)x << self->segmentTable.arityShift) + 1;
+
+        if (y >= self->numberOfNodes) {
+            break;
+        }
+
+        /*
+         * The children are adjacent in one segment.
+         */
+        struct HeapNode **childSlots = __Heap_LocateSlot(self, y);
+        int numberOfChildren = 1 << self->segmentTable.arityShift;
+
+        if (numberOfChildren > self->numberOfNodes - y) {
+            numberOfChildren = self->numberOfNodes - y;
+        }
+
+        int i = 0;
+        int j;
+
+        for (j = 1; j < numberOfChildren; ++j) {
+            if (nodeComparer(childSlots[j], childSlots[i]) < 0) {
+                i = j;
+            }
+        }
+
+        struct HeapNode **slotY = &childSlots[i];
+        y += i;
+
+        if (nodeComparer(node, *slotY) <= 0) {
+            break;
+        }
+
+        (*slotX = *slotY)->slotNumber = x;
+        slotX = slotY;
+        x = y;
+    }
+
+    (*slotX = node)->slotNumber = x;
 }
@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+#include "KeyedHeap.h"
+
+
+static void KeyedHeap_SiftSlotUp(struct KeyedHeap *, struct KeyedHeapSlot *);
+static void KeyedHeap_SiftSlotDown(struct KeyedHeap *, struct KeyedHeapSlot *);
+
+
+void
+KeyedHeap_Initialize(struct KeyedHeap *self)
+{
+    assert(self != NULL);
+    __HeapSegmentTable_Initialize(&self->segmentTable, sizeof(struct KeyedHeapSlot));
+    self->numberOfNodes = 0;
+}
+
+
+void
+KeyedHeap_Finalize(const struct KeyedHeap *self)
+{
+    assert(self != NULL);
+    __HeapSegmentTable_Finalize(&self->segmentTable);
+}
+
+
+void
+KeyedHeap_SetSegmentAllocator(struct KeyedHeap *self, struct Allocator *segmentAllocator)
+{
+    assert(self != NULL);
+    __HeapSegmentTable_SetSegmentAllocator(&self->segmentTable, segmentAllocator);
+}
+
+
+void
+KeyedHeap_SetArity(struct KeyedHeap *self, int arity)
+{
+    assert(self != NULL);
+    assert(self->numberOfNodes == 0);
+    __HeapSegmentTable_SetArity(&self->segmentTable, arity);
+}
+
+
+bool
+KeyedHeap_ShrinkToFit(struct KeyedHeap *self)
+{
+    assert(self != NULL);
+    return __HeapSegmentTable_ShrinkToFit(&self->segmentTable, self->numberOfNodes);
+}
+
+
+bool
+KeyedHeap_InsertNode(struct KeyedHeap *self, struct HeapNode *node, uint64_t key)
+{
+    assert(self != NULL);
+    assert(node != NULL);
+
+    if (self->numberOfNodes + (1 << self->segmentTable.arityShift) - 1
+        >= self->segmentTable.numberOfSlots) {
+        if (!__HeapSegmentTable_IncreaseSegments(&self->segmentTable, 1)) {
+            return false;
+        }
+    }
+
+    struct KeyedHeapSlot *slot = __KeyedHeap_LocateSlot(self, self->numberOfNodes);
+    slot->key = key;
+    (slot->node = node)->slotNumber = self->numberOfNodes++;
+    KeyedHeap_SiftSlotUp(self, slot);
+    return true;
+}
+
+
+void
+KeyedHeap_AdjustNode(struct KeyedHeap *self, const struct HeapNode *node, uint64_t key)
+{
+    assert(self != NULL);
+    assert(node != NULL);
+    struct KeyedHeapSlot *slot = __KeyedHeap_LocateSlot(self, node->slotNumber);
+    uint64_t oldKey = slot->key;
+    slot->key = key;
+
+    if (key < oldKey) {
+        KeyedHeap_SiftSlotUp(self, slot);
+    } else if (key > oldKey) {
+        KeyedHeap_SiftSlotDown(self, slot);
+    }
+}
+
+
+void
+KeyedHeap_RemoveNode(struct KeyedHeap *self, const struct HeapNode *node)
+{
+    assert(self != NULL);
+    assert(node != NULL);
+    struct KeyedHeapSlot *slot = __KeyedHeap_LocateSlot(self, node->slotNumber);
+    uint64_t key = slot->key;
+    *slot = *__KeyedHeap_LocateSlot(self, --self->numberOfNodes);
+    slot->node->slotNumber = node->slotNumber;
+
+    if (slot->key < key) {
+        KeyedHeap_SiftSlotUp(self, slot);
+    } else if (slot->key > key) {
+        KeyedHeap_SiftSlotDown(self, slot);
+    }
+}
+
+
+static void
+KeyedHeap_SiftSlotUp(struct KeyedHeap *self, struct KeyedHeapSlot *slotX)
+{
+    struct KeyedHeapSlot slot = *slotX;
+    int x = slot.node->slotNumber;
+
+    while (x >= 1) {
+        int y = (x - 1u) >> self->segmentTable.arityShift;
+        struct KeyedHeapSlot *slotY = __KeyedHeap_LocateSlot(self, y);
+
+        if (slot.key >= slotY->key) {
+            break;
+        }
+
+        (*slotX = *slotY).node->slotNumber = x;
+        slotX = slotY;
+        x = y;
+    }
+
+    (*slotX = slot).node->slotNumber = x;
+}
+
+
+static void
+KeyedHeap_SiftSlotDown(struct KeyedHeap *self, struct KeyedHeapSlot *slotX)
+{
+    struct KeyedHeapSlot slot = *slotX;
+    int x = slot.node->slotNumber;
+
+    for (;;) {
+        int y = ((unsigned int)x << self->segmentTable.arityShift) + 1;
+
+        if (y >= self->numberOfNodes) {
+            break;
+        }
+
+        struct KeyedHeapSlot *childSlots = __KeyedHeap_LocateSlot(self, y);
+        int numberOfChildren = 1 << self->segmentTable.arityShift;
+
+        if (numberOfChildren > self->numberOfNodes - y) {
+            numberOfChildren = self->numberOfNodes - y;
+        }
+
+        int i = 0;
+        int j;
+
+        for (j = 1; j < numberOfChildren; ++j) {
+            if (childSlots[j].key < childSlots[i].key) {
+                i = j;
+            }
+        }
+
+        if (slot.key <= childSlots[i].key) {
+            break;
+        }
+
+        (*slotX = childSlots[i]).node->slotNumber = x;
+        slotX = &childSlots[i];
+        x = y + i;
+    }
+
+    (*slotX = slot).node->slotNumber = x;
+}
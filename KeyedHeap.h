@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+#pragma once
+
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <assert.h>
+
+#include "Heap.h"
+#include "Vector.h"
+#include "Allocator.h"
+
+
+#define KEYED_HEAP_SEGMENT_LENGTH (HEAP_SEGMENT_SIZE / sizeof(struct KeyedHeapSlot))
+
+
+/*
+ * A min-heap ordered by unsigned 64-bit keys, which are kept in the slots along with the nodes,
+ * so that sifts compare adjacent keys and touch nodes only to update their slot numbers. Slots
+ * are laid out as in `struct Heap`; 4 of them fill a cache line.
+ */
+struct KeyedHeap
+{
+    struct HeapSegmentTable segmentTable;
+    int numberOfNodes;
+};
+
+
+struct KeyedHeapSlot
+{
+    uint64_t key;
+    struct HeapNode *node;
+};
+
+
+static inline struct HeapNode *KeyedHeap_GetTop(const struct KeyedHeap *);
+static inline uint64_t KeyedHeap_GetNodeKey(const struct KeyedHeap *, const struct HeapNode *);
+
+void KeyedHeap_Initialize(struct KeyedHeap *);
+void KeyedHeap_Finalize(const struct KeyedHeap *);
+
+/*
+ * Segments are all `HEAP_SEGMENT_SIZE` bytes, as those of `struct Heap`.
+ */
+void KeyedHeap_SetSegmentAllocator(struct KeyedHeap *, struct Allocator *);
+
+/*
+ * The arity is 2 (the default), 4 or 8.
+ */
+void KeyedHeap_SetArity(struct KeyedHeap *, int);
+bool KeyedHeap_ShrinkToFit(struct KeyedHeap *);
+bool KeyedHeap_InsertNode(struct KeyedHeap *, struct HeapNode *, uint64_t);
+void KeyedHeap_AdjustNode(struct KeyedHeap *, const struct HeapNode *, uint64_t);
+void KeyedHeap_RemoveNode(struct KeyedHeap *, const struct HeapNode *);
+
+static inline struct KeyedHeapSlot *__KeyedHeap_LocateSlot(const struct KeyedHeap *, int);
+
+
+static inline struct HeapNode *
+KeyedHeap_GetTop(const struct KeyedHeap *self)
+{
+    assert(self != NULL);
+
+    if (self->numberOfNodes == 0) {
+        return NULL;
+    }
+
+    return __KeyedHeap_LocateSlot(self, 0)->node;
+}
+
+
+static inline uint64_t
+KeyedHeap_GetNodeKey(const struct KeyedHeap *self, const struct HeapNode *node)
+{
+    assert(self != NULL);
+    assert(node != NULL);
+    return __KeyedHeap_LocateSlot(self, node->slotNumber)->key;
+}
+
+
+static inline struct KeyedHeapSlot *
+__KeyedHeap_LocateSlot(const struct KeyedHeap *self, int slotNumber)
+{
+    struct KeyedHeapSlot **segments = Vector_GetElements(&self->segmentTable.segmentVector.vector);
+    unsigned int slotIndex = slotNumber + (1 << self->segmentTable.arityShift) - 1;
+    return &segments[slotIndex / KEYED_HEAP_SEGMENT_LENGTH][slotIndex % KEYED_HEAP_SEGMENT_LENGTH];
+}
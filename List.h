@@ -8,8 +8,11 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <limits.h>
 #include <assert.h>
 
+#include "Utility.h"
+
 
 #define FOR_EACH_LIST_ITEM(listItem, listHead) \
     for ((listItem) = (listHead)->next; (listItem) != (listHead); (listItem) = (listItem)->next)
@@ -26,6 +29,25 @@
          ; (listItem) = (temp), (temp) = (listItem)->prev)
 
 
+/*
+ * Defines `name##_Sort`, a counterpart of `List_Sort` for lists of `type` linked through `field`,
+ * with `comparer` (taking two `const type *`) inlined.
+ */
+#define DEFINE_LIST_SORT(name, type, field, comparer)                                        \
+    static inline int                                                                        \
+    name##_CompareItems(const struct ListItem *item1, const struct ListItem *item2)          \
+    {                                                                                        \
+        return comparer(CONTAINER_OF(item1, type, field), CONTAINER_OF(item2, type, field)); \
+    }                                                                                        \
+                                                                                             \
+    static inline void                                                                       \
+    name##_Sort(struct ListItem *head)                                                       \
+    {                                                                                        \
+        assert(head != NULL);                                                                \
+        __List_Sort(head, name##_CompareItems);                                              \
+    }
+
+
 struct ListItem
 {
     struct ListItem *prev;
@@ -37,6 +59,11 @@ static inline void List_Initialize(struct ListItem *);
 static inline void List_InsertBack(struct ListItem *, struct ListItem *);
 static inline void List_InsertFront(struct ListItem *, struct ListItem *);
 static inline bool List_IsEmpty(const struct ListItem *);
+
+/*
+ * Moves all items of the other list to the back of the list, leaving the other list empty.
+ */
+static inline void List_Splice(struct ListItem *, struct ListItem *);
 #define List_GetBack ListItem_GetPrev
 #define List_GetFront ListItem_GetNext
 
@@ -48,8 +75,17 @@ static inline struct ListItem *ListItem_GetPrev(const struct ListItem *);
 static inline struct ListItem *ListItem_GetNext(const struct ListItem *);
 static inline void __ListItem_Insert(struct ListItem *, struct ListItem *, struct ListItem *);
 
+/*
+ * Stable merge sort.
+ */
 void List_Sort(struct ListItem *, int (*)(const struct ListItem *, const struct ListItem *));
 
+static inline void __List_Sort(struct ListItem *, int (*)(const struct ListItem *
+                                                         , const struct ListItem *));
+static inline struct ListItem *__List_MergeRuns(struct ListItem *, struct ListItem *
+                                                , int (*)(const struct ListItem *
+                                                          , const struct ListItem *));
+
 
 static inline void
 List_Initialize(struct ListItem *head)
@@ -86,6 +122,22 @@ List_IsEmpty(const struct ListItem *head)
 }
 
 
+static inline void
+List_Splice(struct ListItem *head, struct ListItem *otherHead)
+{
+    assert(head != NULL);
+    assert(otherHead != NULL);
+
+    if (otherHead->prev == otherHead) {
+        return;
+    }
+
+    (otherHead->next->prev = head->prev)->next = otherHead->next;
+    (otherHead->prev->next = head)->prev = otherHead->prev;
+    List_Initialize(otherHead);
+}
+
+
 static inline void
 ListItem_InsertBefore(struct ListItem *self, struct ListItem *other)
 {
@@ -144,3 +196,89 @@ __ListItem_Insert(struct ListItem *self, struct ListItem *prev, struct ListItem
     (self->prev = prev)->next = self;
     (self->next = next)->prev = self;
 }
+
+
+static inline __attribute__((always_inline)) void
+__List_Sort(struct ListItem *head, int (*itemComparer)(const struct ListItem *
+                                                       , const struct ListItem *))
+{
+    if (head->next == head->prev) {
+        return;
+    }
+
+    /*
+     * Items are merged bottom-up through a singly linked chain, `runs[i]` being either empty or
+     * a sorted run of 2^i items, all preceding the items of `runs[i - 1]`.
+     */
+    struct ListItem *runs[sizeof(size_t) * CHAR_BIT];
+    int numberOfRuns = 0;
+    struct ListItem *item = head->next;
+    head->prev->next = NULL;
+
+    do {
+        struct ListItem *run = item;
+        item = item->next;
+        run->next = NULL;
+        int i;
+
+        for (i = 0; i < numberOfRuns && runs[i] != NULL; ++i) {
+            run = __List_MergeRuns(runs[i], run, itemComparer);
+            runs[i] = NULL;
+        }
+
+        if (i == numberOfRuns) {
+            ++numberOfRuns;
+        }
+
+        runs[i] = run;
+    } while (item != NULL);
+
+    struct ListItem *run = NULL;
+    int i;
+
+    for (i = 0; i < numberOfRuns; ++i) {
+        if (runs[i] != NULL) {
+            run = run == NULL ? runs[i] : __List_MergeRuns(runs[i], run, itemComparer);
+        }
+    }
+
+    head->next = run;
+    struct ListItem *itemPrev = head;
+
+    for (item = run; item != NULL; item = item->next) {
+        item->prev = itemPrev;
+        itemPrev = item;
+    }
+
+    itemPrev->next = head;
+    head->prev = itemPrev;
+}
+
+
+static inline __attribute__((always_inline)) struct ListItem *
+__List_MergeRuns(struct ListItem *run1, struct ListItem *run2
+                 , int (*itemComparer)(const struct ListItem *, const struct ListItem *))
+{
+    struct ListItem *run;
+    struct ListItem **runTail = &run;
+
+    for (;;) {
+        if (itemComparer(run2, run1) < 0) {
+            *runTail = run2;
+            runTail = &run2->next;
+
+            if ((run2 = run2->next) == NULL) {
+                *runTail = run1;
+                return run;
+            }
+        } else {
+            *runTail = run1;
+            runTail = &run1->next;
+
+            if ((run1 = run1->next) == NULL) {
+                *runTail = run2;
+                return run;
+            }
+        }
+    }
+}
@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+/*
+ * Replaces the malloc family with `struct SizeClassAllocator`s, one per thread, for measurement
+ * against the system allocator:
+ *
+ *     cc -O2 -shared -fPIC -o libMallocShim.so MallocShim.c SizeClassAllocator.c MemoryPool.c \
+ *        MemoryChunkProvider.c
+ *     LD_PRELOAD=./libMallocShim.so <program>
+ *
+ * Builds with `-DALLOCATION_PROFILER` also need AllocationProfiler.c and `-lm`.
+ *
+ * The allocator of an exiting thread is abandoned rather than finalized, since blocks of it may
+ * still be in use by other threads.
+ */
+
+
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "SizeClassAllocator.h"
+
+
+static struct SizeClassAllocator *GetAllocator(void);
+
+
+static __thread struct SizeClassAllocator *Allocator __attribute__((tls_model("initial-exec")));
+
+
+void *
+malloc(size_t size)
+{
+    struct SizeClassAllocator *allocator = GetAllocator();
+
+    if (allocator == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    void *block = SizeClassAllocator_Allocate(allocator, size);
+
+    if (block == NULL) {
+        errno = ENOMEM;
+    }
+
+    return block;
+}
+
+
+void
+free(void *block)
+{
+    struct SizeClassAllocator *allocator = GetAllocator();
+
+    if (block == NULL || allocator == NULL) {
+        return;
+    }
+
+    SizeClassAllocator_Free(allocator, block);
+}
+
+
+void *
+calloc(size_t numberOfElements, size_t elementSize)
+{
+    size_t size;
+
+    if (__builtin_mul_overflow(numberOfElements, elementSize, &size)) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    struct SizeClassAllocator *allocator = GetAllocator();
+
+    if (allocator == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    void *block = SizeClassAllocator_Allocate(allocator, size);
+
+    if (block == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    memset(block, 0, size);
+    return block;
+}
+
+
+void *
+realloc(void *block, size_t size)
+{
+    if (block != NULL && size == 0) {
+        free(block);
+        return NULL;
+    }
+
+    struct SizeClassAllocator *allocator = GetAllocator();
+
+    if (allocator == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    void *newBlock = SizeClassAllocator_Reallocate(allocator, block, size);
+
+    if (newBlock == NULL) {
+        errno = ENOMEM;
+    }
+
+    return newBlock;
+}
+
+
+int
+posix_memalign(void **block, size_t alignment, size_t size)
+{
+    if (alignment < sizeof(void *) || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+
+    struct SizeClassAllocator *allocator = GetAllocator();
+
+    if (allocator == NULL) {
+        return ENOMEM;
+    }
+
+    void *newBlock = SizeClassAllocator_AllocateAligned(allocator, alignment, size);
+
+    if (newBlock == NULL) {
+        return ENOMEM;
+    }
+
+    *block = newBlock;
+    return 0;
+}
+
+
+void *
+aligned_alloc(size_t alignment, size_t size)
+{
+    void *block;
+    int errorNumber = posix_memalign(&block, alignment < sizeof(void *) ? sizeof(void *)
+                                                                        : alignment, size);
+
+    if (errorNumber != 0) {
+        errno = errorNumber;
+        return NULL;
+    }
+
+    return block;
+}
+
+
+void *
+reallocarray(void *block, size_t numberOfElements, size_t elementSize)
+{
+    size_t size;
+
+    if (__builtin_mul_overflow(numberOfElements, elementSize, &size)) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    return realloc(block, size);
+}
+
+
+void *
+memalign(size_t alignment, size_t size)
+{
+    return aligned_alloc(alignment, size);
+}
+
+
+void *
+valloc(size_t size)
+{
+    return aligned_alloc(sysconf(_SC_PAGESIZE), size);
+}
+
+
+size_t
+malloc_usable_size(void *block)
+{
+    if (block == NULL) {
+        return 0;
+    }
+
+    return SizeClassAllocator_GetBlockSize(block);
+}
+
+
+static struct SizeClassAllocator *
+GetAllocator(void)
+{
+    struct SizeClassAllocator *allocator = Allocator;
+
+    if (allocator != NULL) {
+        return allocator;
+    }
+
+    allocator = mmap(NULL, sizeof *allocator, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS
+                     , -1, 0);
+
+    if (allocator == MAP_FAILED) {
+        return NULL;
+    }
+
+    SizeClassAllocator_Initialize(allocator);
+    Allocator = allocator;
+    return allocator;
+}
@@ -0,0 +1,282 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+#include "MemoryChunkProvider.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <string.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "Utility.h"
+
+
+static void *DefaultMemoryChunkProvider_AllocateChunk(struct MemoryChunkProvider *, size_t);
+static void DefaultMemoryChunkProvider_FreeChunk(struct MemoryChunkProvider *, void *, size_t);
+static void *MMapMemoryChunkProvider_AllocateChunk(struct MemoryChunkProvider *, size_t);
+static void *TransparentHugePageMemoryChunkProvider_AllocateChunk(struct MemoryChunkProvider *
+                                                                  , size_t);
+static void *HugeTLBMemoryChunkProvider_AllocateChunk(struct MemoryChunkProvider *, size_t);
+static void MMapMemoryChunkProvider_FreeChunk(struct MemoryChunkProvider *, void *, size_t);
+static void *MemoryChunkCache_AllocateChunk(struct MemoryChunkProvider *, size_t);
+static void MemoryChunkCache_FreeChunk(struct MemoryChunkProvider *, void *, size_t);
+
+static void *MapAlignedChunk(size_t);
+static void UnmapMemory(void *, size_t);
+static size_t GetHugePageSize(void);
+
+
+struct MemoryChunkProvider DefaultMemoryChunkProvider = {
+    .allocateChunk = DefaultMemoryChunkProvider_AllocateChunk,
+    .freeChunk = DefaultMemoryChunkProvider_FreeChunk
+};
+
+struct MemoryChunkProvider MMapMemoryChunkProvider = {
+    .allocateChunk = MMapMemoryChunkProvider_AllocateChunk,
+    .freeChunk = MMapMemoryChunkProvider_FreeChunk
+};
+
+struct MemoryChunkProvider TransparentHugePageMemoryChunkProvider = {
+    .allocateChunk = TransparentHugePageMemoryChunkProvider_AllocateChunk,
+    .freeChunk = MMapMemoryChunkProvider_FreeChunk
+};
+
+struct MemoryChunkProvider HugeTLBMemoryChunkProvider = {
+    .allocateChunk = HugeTLBMemoryChunkProvider_AllocateChunk,
+    .freeChunk = MMapMemoryChunkProvider_FreeChunk
+};
+
+
+void
+MemoryChunkCache_Initialize(struct MemoryChunkCache *self
+                            , struct MemoryChunkProvider *backingProvider, size_t chunkSize
+                            , int maxNumberOfChunks)
+{
+    assert(self != NULL);
+    assert(backingProvider != NULL);
+    assert(chunkSize >= sizeof(struct ListItem) && (chunkSize & (chunkSize - 1)) == 0);
+    assert(maxNumberOfChunks >= 0);
+    self->provider.allocateChunk = MemoryChunkCache_AllocateChunk;
+    self->provider.freeChunk = MemoryChunkCache_FreeChunk;
+    self->backingProvider = backingProvider;
+    self->chunkSize = chunkSize;
+    self->maxNumberOfChunks = maxNumberOfChunks;
+    self->numberOfChunks = 0;
+    List_Initialize(&self->chunkListHead);
+}
+
+
+void
+MemoryChunkCache_Finalize(const struct MemoryChunkCache *self)
+{
+    assert(self != NULL);
+    struct ListItem *chunkListItem;
+    struct ListItem *temp;
+
+    FOR_EACH_LIST_ITEM_SAFE_REVERSE(chunkListItem, temp, &self->chunkListHead) {
+        self->backingProvider->freeChunk(self->backingProvider, chunkListItem, self->chunkSize);
+    }
+}
+
+
+static void *
+DefaultMemoryChunkProvider_AllocateChunk(struct MemoryChunkProvider *self, size_t chunkSize)
+{
+    (void)self;
+    void *chunk;
+    int errorNumber = posix_memalign(&chunk, chunkSize, chunkSize);
+
+    if (errorNumber != 0) {
+        assert(errorNumber != EINVAL);
+        return NULL;
+    }
+
+    return chunk;
+}
+
+
+static void
+DefaultMemoryChunkProvider_FreeChunk(struct MemoryChunkProvider *self, void *chunk
+                                     , size_t chunkSize)
+{
+    (void)self;
+    (void)chunkSize;
+    free(chunk);
+}
+
+
+static void *
+MMapMemoryChunkProvider_AllocateChunk(struct MemoryChunkProvider *self, size_t chunkSize)
+{
+    (void)self;
+    return MapAlignedChunk(chunkSize);
+}
+
+
+static void *
+TransparentHugePageMemoryChunkProvider_AllocateChunk(struct MemoryChunkProvider *self
+                                                     , size_t chunkSize)
+{
+    (void)self;
+    void *chunk = MapAlignedChunk(chunkSize);
+
+    if (chunk == NULL) {
+        return NULL;
+    }
+
+#ifdef MADV_HUGEPAGE
+    madvise(chunk, chunkSize, MADV_HUGEPAGE);
+#endif
+    return chunk;
+}
+
+
+static void *
+HugeTLBMemoryChunkProvider_AllocateChunk(struct MemoryChunkProvider *self, size_t chunkSize)
+{
+    (void)self;
+#ifdef MAP_HUGETLB
+    size_t hugePageSize = GetHugePageSize();
+
+    /*
+     * Huge TLB mappings are rounded up to whole huge pages, which a chunk must consist of, or
+     * they could not be unmapped by its size.
+     */
+    if (hugePageSize == 0 || chunkSize % hugePageSize != 0) {
+        return NULL;
+    }
+
+    void *chunk = mmap(NULL, chunkSize, PROT_READ | PROT_WRITE
+                       , MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+    if (chunk == MAP_FAILED) {
+        return NULL;
+    }
+
+    if (((uintptr_t)chunk & (chunkSize - 1)) != 0) {
+        UnmapMemory(chunk, chunkSize);
+        return NULL;
+    }
+
+    return chunk;
+#else
+    (void)chunkSize;
+    return NULL;
+#endif
+}
+
+
+static void
+MMapMemoryChunkProvider_FreeChunk(struct MemoryChunkProvider *self, void *chunk, size_t chunkSize)
+{
+    (void)self;
+    UnmapMemory(chunk, chunkSize);
+}
+
+
+static void *
+MemoryChunkCache_AllocateChunk(struct MemoryChunkProvider *provider, size_t chunkSize)
+{
+    struct MemoryChunkCache *self = CONTAINER_OF(provider, struct MemoryChunkCache, provider);
+
+    if (chunkSize != self->chunkSize || self->numberOfChunks == 0) {
+        return self->backingProvider->allocateChunk(self->backingProvider, chunkSize);
+    }
+
+    struct ListItem *chunkListItem = List_GetBack(&self->chunkListHead);
+    ListItem_Remove(chunkListItem);
+    --self->numberOfChunks;
+    return chunkListItem;
+}
+
+
+static void
+MemoryChunkCache_FreeChunk(struct MemoryChunkProvider *provider, void *chunk, size_t chunkSize)
+{
+    struct MemoryChunkCache *self = CONTAINER_OF(provider, struct MemoryChunkCache, provider);
+
+    if (chunkSize != self->chunkSize || self->numberOfChunks == self->maxNumberOfChunks) {
+        self->backingProvider->freeChunk(self->backingProvider, chunk, chunkSize);
+        return;
+    }
+
+    List_InsertBack(&self->chunkListHead, chunk);
+    ++self->numberOfChunks;
+}
+
+
+static void *
+MapAlignedChunk(size_t chunkSize)
+{
+    char *mapping = mmap(NULL, 2 * chunkSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS
+                         , -1, 0);
+
+    if (mapping == MAP_FAILED) {
+        return NULL;
+    }
+
+    char *chunk = (char *)(((uintptr_t)mapping + chunkSize - 1) & ~(chunkSize - 1));
+
+    if (chunk > mapping) {
+        UnmapMemory(mapping, chunk - mapping);
+    }
+
+    UnmapMemory(chunk + chunkSize, mapping + chunkSize - chunk);
+    return chunk;
+}
+
+
+static void
+UnmapMemory(void *memory, size_t memorySize)
+{
+    int result = munmap(memory, memorySize);
+    assert(result == 0);
+    (void)result;
+}
+
+
+static size_t
+GetHugePageSize(void)
+{
+    static atomic_size_t HugePageSize;
+    size_t hugePageSize = atomic_load_explicit(&HugePageSize, memory_order_relaxed);
+
+    if (hugePageSize != 0) {
+        return hugePageSize;
+    }
+
+    /*
+     * Read without stdio, which may allocate memory through the pools backed by this provider.
+     */
+    int fd = open("/proc/meminfo", O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0) {
+        return 0;
+    }
+
+    char buffer[4096];
+    ssize_t bufferSize = read(fd, buffer, sizeof buffer - 1);
+    close(fd);
+
+    if (bufferSize <= 0) {
+        return 0;
+    }
+
+    buffer[bufferSize] = '\0';
+    const char *field = strstr(buffer, "Hugepagesize:");
+
+    if (field == NULL) {
+        return 0;
+    }
+
+    hugePageSize = strtoul(field + sizeof "Hugepagesize:" - 1, NULL, 10) * 1024;
+    atomic_store_explicit(&HugePageSize, hugePageSize, memory_order_relaxed);
+    return hugePageSize;
+}
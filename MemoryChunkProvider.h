@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+#pragma once
+
+
+#include <stddef.h>
+
+#include "List.h"
+
+
+/*
+ * `allocateChunk` returns a chunk of the given size aligned to that size (a power of two), or
+ * NULL. Stateful providers embed this structure and recover themselves with `CONTAINER_OF`.
+ */
+struct MemoryChunkProvider
+{
+    void *(*allocateChunk)(struct MemoryChunkProvider *, size_t);
+    void (*freeChunk)(struct MemoryChunkProvider *, void *, size_t);
+};
+
+
+extern struct MemoryChunkProvider DefaultMemoryChunkProvider;
+extern struct MemoryChunkProvider MMapMemoryChunkProvider;
+extern struct MemoryChunkProvider TransparentHugePageMemoryChunkProvider;
+/*
+ * Only provides chunks whose size is a multiple of the huge page size (say 2 MiB).
+ */
+extern struct MemoryChunkProvider HugeTLBMemoryChunkProvider;
+
+
+/*
+ * Keeps up to a given number of freed chunks of one size for reuse, so that allocators sharing
+ * the cache (say pools and arenas) recycle each other's chunks. Not thread-safe.
+ */
+struct MemoryChunkCache
+{
+    struct MemoryChunkProvider provider;
+    struct MemoryChunkProvider *backingProvider;
+    size_t chunkSize;
+    int maxNumberOfChunks;
+    int numberOfChunks;
+    struct ListItem chunkListHead;
+};
+
+
+void MemoryChunkCache_Initialize(struct MemoryChunkCache *, struct MemoryChunkProvider *, size_t
+                                 , int);
+void MemoryChunkCache_Finalize(const struct MemoryChunkCache *);
@@ -5,48 +5,145 @@
 
 #include "MemoryPool.h"
 
-#include <stdlib.h>
 #include <stdbool.h>
 #include <assert.h>
-#include <errno.h>
 #include <stdint.h>
-
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#ifdef MEMORY_POOL_STATISTICS
+#include <pthread.h>
+#endif
+
+#include "AllocationProfiler.h"
 #include "Utility.h"
 
 
-#define MEMORY_CHUNK_SIZE ((size_t)65536)
+#define CACHE_LINE_SIZE 64
+#define BITMAP_WORD_WIDTH 64
+#define MAX_NUMBER_OF_CHUNK_BATCHES 16
+
+#define FULL_CHUNK_LIST_INDEX 0
+#define EMPTY_CHUNK_LIST_INDEX (MEMORY_POOL_NUMBER_OF_OCCUPANCY_BUCKETS + 1)
+#define NUMBER_OF_CHUNK_LISTS (MEMORY_POOL_NUMBER_OF_OCCUPANCY_BUCKETS + 2)
+
+#define NUMBER_OF_BITMAP_WORDS(numberOfBits) \
+    (((numberOfBits) + BITMAP_WORD_WIDTH - 1) / BITMAP_WORD_WIDTH)
+
+
+#ifdef MEMORY_POOL_STATISTICS
+#define MEMORY_POOL_COUNT(self, counter, delta) \
+    ((self)->counters.counter += (delta))
+
+#define MEMORY_POOL_COUNT_LIVE_BLOCKS(self, delta)                                      \
+    do {                                                                                \
+        if (((self)->counters.numberOfLiveBlocks += (delta))                            \
+            > (self)->counters.peakNumberOfLiveBlocks) {                                \
+            (self)->counters.peakNumberOfLiveBlocks = (self)->counters.numberOfLiveBlocks; \
+        }                                                                               \
+    } while (0)
+#else
+#define MEMORY_POOL_COUNT(self, counter, delta) \
+    ((void)0)
+
+#define MEMORY_POOL_COUNT_LIVE_BLOCKS(self, delta) \
+    ((void)0)
+#endif
 
 
 struct MemoryChunk
 {
     struct ListItem listItem;
+    struct MemoryPool *pool;
     void **freeSlot;
+    char *nextUncarvedBlock;
+    size_t colorOffset;
     int numberOfFreeSlots;
+    long long emptyTime;
+    _Atomic(void *) remoteFreeSlot;
+    struct MemoryChunk *nextPendingChunk;
+    int bitmapHint;
+    uint64_t bitmap[];
 };
 
 
+struct MemoryChunkBatch
+{
+    struct MemoryChunk *chunk;
+    void **firstSlot;
+    void **lastSlot;
+    int numberOfSlots;
+};
+
+
+static void MemoryPool_LayOutChunks(struct MemoryPool *);
+static size_t MemoryPool_GetChunkColorSpacing(const struct MemoryPool *);
+static struct MemoryChunk *MemoryPool_GetUsableChunk(struct MemoryPool *);
 static bool MemoryPool_IncreaseChunks(struct MemoryPool *);
+static void **MemoryPool_TakeSlot(const struct MemoryPool *, struct MemoryChunk *);
+static void MemoryPool_PutSlots(struct MemoryPool *, struct MemoryChunk *, void **, void **, int);
+static void MemoryPool_PutBlocks(struct MemoryPool *, int, void *const *);
+static void MemoryPool_PutChunkBatches(struct MemoryPool *, const struct MemoryChunkBatch *, int);
+static int MemoryPool_GetChunkListIndex(const struct MemoryPool *, int);
+static void MemoryPool_FileChunk(struct MemoryPool *, struct MemoryChunk *);
+static void MemoryPool_UnfileChunk(struct MemoryPool *, struct MemoryChunk *, int);
+static void MemoryPool_RefileChunk(struct MemoryPool *, struct MemoryChunk *, int);
+static void MemoryPool_CollectRemoteFreeBlocks(struct MemoryPool *);
+static char *MemoryPool_LocateFirstBlock(const struct MemoryPool *, const struct MemoryChunk *);
+static void MemoryPool_TrimChunk(const struct MemoryPool *, struct MemoryChunk *);
+static bool MemoryPool_ChunkIsTrimmed(const struct MemoryPool *, const struct MemoryChunk *);
+
+static struct MemoryChunk *LocateMemoryChunk(const void *, size_t);
+static long long GetTime(void);
 
-static struct MemoryChunk *LocateMemoryChunk(const void *);
 
+const size_t MemoryChunkPayloadSize = MEMORY_CHUNK_SIZE - sizeof(struct MemoryChunk);
 
-static const size_t MemoryChunkPayloadSize = MEMORY_CHUNK_SIZE - sizeof(struct MemoryChunk);
+#ifdef MEMORY_POOL_STATISTICS
+static pthread_mutex_t RegistryMutex = PTHREAD_MUTEX_INITIALIZER;
+static struct ListItem RegistryListHead = {&RegistryListHead, &RegistryListHead};
+#endif
 
 
 void
 MemoryPool_Initialize(struct MemoryPool *self, size_t blockSize)
 {
     assert(self != NULL);
-    assert(blockSize <= MemoryChunkPayloadSize);
+    assert(blockSize <= MAX_MEMORY_CHUNK_SIZE - sizeof(struct MemoryChunk));
 
     if (blockSize < sizeof(void *)) {
         blockSize = sizeof(void *);
     }
 
+    size_t chunkSize = MEMORY_CHUNK_SIZE;
+
+    while (chunkSize - sizeof(struct MemoryChunk) < blockSize) {
+        chunkSize *= 2;
+    }
+
     self->blockSize = blockSize;
-    self->numberOfSlotsPerChunk = MemoryChunkPayloadSize / blockSize;
-    List_Initialize(&self->usableChunkListHead);
-    List_Initialize(&self->unusableChunkListHead);
+    self->chunkSize = chunkSize;
+    self->chunkProvider = &DefaultMemoryChunkProvider;
+    self->usesBitmap = false;
+    self->colorsChunks = true;
+    MemoryPool_LayOutChunks(self);
+    self->maxNumberOfRetainedChunks = -1;
+    self->chunkDecayTime = 0;
+    self->chunkListMask = 0;
+    int i;
+
+    for (i = 0; i < NUMBER_OF_CHUNK_LISTS; ++i) {
+        List_Initialize(&self->chunkListHeads[i]);
+    }
+
+    atomic_init(&self->pendingChunks, NULL);
+#ifdef MEMORY_POOL_STATISTICS
+    memset(&self->counters, 0, sizeof self->counters);
+    pthread_mutex_lock(&RegistryMutex);
+    List_InsertBack(&RegistryListHead, &self->listItem);
+    pthread_mutex_unlock(&RegistryMutex);
+#endif
 }
 
 
@@ -54,15 +151,122 @@ void
 MemoryPool_Finalize(const struct MemoryPool *self)
 {
     assert(self != NULL);
-    struct ListItem *chunkListItem;
-    struct ListItem *temp;
-
-    FOR_EACH_LIST_ITEM_SAFE_REVERSE(chunkListItem, temp, &self->usableChunkListHead) {
-        free(CONTAINER_OF(chunkListItem, struct MemoryChunk, listItem));
+#ifdef MEMORY_POOL_STATISTICS
+    pthread_mutex_lock(&RegistryMutex);
+    ListItem_Remove(&self->listItem);
+    pthread_mutex_unlock(&RegistryMutex);
+#endif
+    int i;
+
+    for (i = 0; i < NUMBER_OF_CHUNK_LISTS; ++i) {
+        struct ListItem *chunkListItem;
+        struct ListItem *temp;
+
+        FOR_EACH_LIST_ITEM_SAFE_REVERSE(chunkListItem, temp, &self->chunkListHeads[i]) {
+            self->chunkProvider->freeChunk(self->chunkProvider
+                                           , CONTAINER_OF(chunkListItem, struct MemoryChunk
+                                                          , listItem)
+                                           , self->chunkSize);
+        }
     }
+}
+
+
+void
+MemoryPool_SetChunkSize(struct MemoryPool *self, size_t chunkSize)
+{
+    assert(self != NULL);
+    assert(self->chunkListMask == 0);
+    assert(chunkSize >= MEMORY_CHUNK_SIZE && chunkSize <= MAX_MEMORY_CHUNK_SIZE);
+    assert((chunkSize & (chunkSize - 1)) == 0);
+    assert(self->blockSize <= chunkSize - sizeof(struct MemoryChunk));
+    self->chunkSize = chunkSize;
+    MemoryPool_LayOutChunks(self);
+}
+
+
+void
+MemoryPool_SetChunkProvider(struct MemoryPool *self, struct MemoryChunkProvider *chunkProvider)
+{
+    assert(self != NULL);
+    assert(self->chunkListMask == 0);
+    assert(chunkProvider != NULL);
+    self->chunkProvider = chunkProvider;
+}
+
+
+void
+MemoryPool_SetChunkRetention(struct MemoryPool *self, int maxNumberOfRetainedChunks
+                             , long chunkDecayTime)
+{
+    assert(self != NULL);
+    assert(maxNumberOfRetainedChunks >= 0);
+    assert(chunkDecayTime >= 0);
+    self->maxNumberOfRetainedChunks = maxNumberOfRetainedChunks;
+    self->chunkDecayTime = chunkDecayTime;
+}
+
 
-    FOR_EACH_LIST_ITEM_SAFE_REVERSE(chunkListItem, temp, &self->unusableChunkListHead) {
-        free(CONTAINER_OF(chunkListItem, struct MemoryChunk, listItem));
+void
+MemoryPool_EnableBitmap(struct MemoryPool *self)
+{
+    assert(self != NULL);
+    assert(self->chunkListMask == 0);
+    self->usesBitmap = true;
+    MemoryPool_LayOutChunks(self);
+}
+
+
+void
+MemoryPool_DisableChunkColoring(struct MemoryPool *self)
+{
+    assert(self != NULL);
+    assert(self->chunkListMask == 0);
+    self->colorsChunks = false;
+    MemoryPool_LayOutChunks(self);
+}
+
+
+void
+MemoryPool_ForEachLiveBlock(struct MemoryPool *self, void (*callback)(void *, void *)
+                            , void *context)
+{
+    assert(self != NULL);
+    assert(self->usesBitmap);
+    assert(callback != NULL);
+    MemoryPool_CollectRemoteFreeBlocks(self);
+    int numberOfBitmapWords = NUMBER_OF_BITMAP_WORDS(self->numberOfSlotsPerChunk);
+    uint64_t lastBitmapWordMask = ~(uint64_t)0 >> (numberOfBitmapWords * BITMAP_WORD_WIDTH
+                                                   - self->numberOfSlotsPerChunk);
+    int i;
+
+    /*
+     * Lists go from the sparsest to the fullest: freeing blocks only moves chunks to sparser
+     * lists, so no chunk is visited twice.
+     */
+    for (i = EMPTY_CHUNK_LIST_INDEX - 1; i >= FULL_CHUNK_LIST_INDEX; --i) {
+        struct ListItem *chunkListItem;
+        struct ListItem *temp;
+
+        FOR_EACH_LIST_ITEM_SAFE(chunkListItem, temp, &self->chunkListHeads[i]) {
+            struct MemoryChunk *chunk = CONTAINER_OF(chunkListItem, struct MemoryChunk, listItem);
+            char *firstBlock = MemoryPool_LocateFirstBlock(self, chunk);
+            int j;
+
+            for (j = 0; j < numberOfBitmapWords; ++j) {
+                uint64_t liveBits = ~chunk->bitmap[j];
+
+                if (j == numberOfBitmapWords - 1) {
+                    liveBits &= lastBitmapWordMask;
+                }
+
+                while (liveBits != 0) {
+                    int k = j * BITMAP_WORD_WIDTH + __builtin_ctzll(liveBits);
+                    liveBits &= liveBits - 1;
+                    callback(firstBlock - k * self->blockSize, context);
+                }
+            }
+        }
     }
 }
 
@@ -71,18 +275,49 @@ void
 MemoryPool_ShrinkToFit(struct MemoryPool *self)
 {
     assert(self != NULL);
+    MemoryPool_CollectRemoteFreeBlocks(self);
+    struct ListItem *emptyChunkListHead = &self->chunkListHeads[EMPTY_CHUNK_LIST_INDEX];
     struct ListItem *chunkListItem;
     struct ListItem *temp;
 
-    FOR_EACH_LIST_ITEM_SAFE(chunkListItem, temp, &self->usableChunkListHead) {
+    if (self->maxNumberOfRetainedChunks < 0) {
+        FOR_EACH_LIST_ITEM_SAFE(chunkListItem, temp, emptyChunkListHead) {
+            self->chunkProvider->freeChunk(self->chunkProvider
+                                           , CONTAINER_OF(chunkListItem, struct MemoryChunk
+                                                          , listItem)
+                                           , self->chunkSize);
+            MEMORY_POOL_COUNT(self, numberOfChunkReleases, 1);
+        }
+
+        List_Initialize(emptyChunkListHead);
+        self->chunkListMask &= ~(1u << EMPTY_CHUNK_LIST_INDEX);
+        return;
+    }
+
+    long long time = GetTime();
+    int numberOfRetainedChunks = 0;
+
+    /*
+     * Empty chunks are filed at the back as they become empty, and trimmed ones are moved to the
+     * front, so the most recently emptied chunks are the first to be retained (and reused).
+     */
+    FOR_EACH_LIST_ITEM_SAFE_REVERSE(chunkListItem, temp, emptyChunkListHead) {
         struct MemoryChunk *chunk = CONTAINER_OF(chunkListItem, struct MemoryChunk, listItem);
 
-        if (chunk->numberOfFreeSlots < self->numberOfSlotsPerChunk) {
-            break;
+        if (MemoryPool_ChunkIsTrimmed(self, chunk)) {
+            continue;
+        }
+
+        if (numberOfRetainedChunks < self->maxNumberOfRetainedChunks
+            && time - chunk->emptyTime < self->chunkDecayTime) {
+            ++numberOfRetainedChunks;
+            continue;
         }
 
+        MemoryPool_TrimChunk(self, chunk);
         ListItem_Remove(&chunk->listItem);
-        free(chunk);
+        List_InsertFront(emptyChunkListHead, &chunk->listItem);
+        MEMORY_POOL_COUNT(self, numberOfChunkTrims, 1);
     }
 }
 
@@ -91,99 +326,603 @@ void *
 MemoryPool_AllocateBlock(struct MemoryPool *self)
 {
     assert(self != NULL);
+    struct MemoryChunk *chunk = MemoryPool_GetUsableChunk(self);
 
-    if (List_IsEmpty(&self->usableChunkListHead)) {
-        if (!MemoryPool_IncreaseChunks(self)) {
-            return NULL;
+    if (chunk == NULL) {
+        return NULL;
+    }
+
+    void **slot = MemoryPool_TakeSlot(self, chunk);
+    MemoryPool_RefileChunk(self, chunk, chunk->numberOfFreeSlots--);
+    MEMORY_POOL_COUNT(self, numberOfAllocations, 1);
+    MEMORY_POOL_COUNT_LIVE_BLOCKS(self, 1);
+    ALLOCATION_PROFILER_RECORD_ALLOCATION(slot, self->blockSize);
+    return slot;
+}
+
+
+void
+MemoryPool_FreeBlock(struct MemoryPool *self, void *block)
+{
+    assert(self != NULL);
+    assert(block != NULL);
+    ALLOCATION_PROFILER_RECORD_FREE(block);
+    MemoryPool_PutSlots(self, LocateMemoryChunk(block, self->chunkSize), block, block, 1);
+    MEMORY_POOL_COUNT(self, numberOfFrees, 1);
+    MEMORY_POOL_COUNT_LIVE_BLOCKS(self, -1);
+}
+
+
+bool
+MemoryPool_AllocateBlocks(struct MemoryPool *self, int numberOfBlocks, void **blocks)
+{
+    assert(self != NULL);
+    assert(numberOfBlocks >= 0);
+    assert(blocks != NULL || numberOfBlocks == 0);
+    int i = 0;
+
+    while (i < numberOfBlocks) {
+        struct MemoryChunk *chunk = MemoryPool_GetUsableChunk(self);
+
+        if (chunk == NULL) {
+            /*
+             * Blocks taken are put back uncounted, as if never allocated.
+             */
+            MemoryPool_PutBlocks(self, i, blocks);
+            return false;
         }
+
+        int numberOfFreeSlots = chunk->numberOfFreeSlots;
+        int n = numberOfBlocks - i;
+
+        if (n > numberOfFreeSlots) {
+            n = numberOfFreeSlots;
+        }
+
+        chunk->numberOfFreeSlots -= n;
+
+        do {
+            blocks[i++] = MemoryPool_TakeSlot(self, chunk);
+        } while (--n >= 1);
+
+        MemoryPool_RefileChunk(self, chunk, numberOfFreeSlots);
     }
 
-    struct MemoryChunk *chunk = CONTAINER_OF(List_GetBack(&self->usableChunkListHead)
-                                             , struct MemoryChunk, listItem);
-    void **slot = chunk->freeSlot;
-    chunk->freeSlot = *slot;
+    MEMORY_POOL_COUNT(self, numberOfAllocations, numberOfBlocks);
+    MEMORY_POOL_COUNT_LIVE_BLOCKS(self, numberOfBlocks);
 
-    if (--chunk->numberOfFreeSlots == 0) {
-        ListItem_Remove(&chunk->listItem);
-        List_InsertBack(&self->unusableChunkListHead, &chunk->listItem);
+    for (i = 0; i < numberOfBlocks; ++i) {
+        ALLOCATION_PROFILER_RECORD_ALLOCATION(blocks[i], self->blockSize);
     }
 
-    return slot;
+    return true;
 }
 
 
 void
-MemoryPool_FreeBlock(struct MemoryPool *self, void *block)
+MemoryPool_FreeBlocks(struct MemoryPool *self, int numberOfBlocks, void *const *blocks)
+{
+    assert(self != NULL);
+    assert(numberOfBlocks >= 0);
+    assert(blocks != NULL || numberOfBlocks == 0);
+    int i;
+
+    for (i = 0; i < numberOfBlocks; ++i) {
+        ALLOCATION_PROFILER_RECORD_FREE(blocks[i]);
+    }
+
+    MemoryPool_PutBlocks(self, numberOfBlocks, blocks);
+    MEMORY_POOL_COUNT(self, numberOfFrees, numberOfBlocks);
+    MEMORY_POOL_COUNT_LIVE_BLOCKS(self, -numberOfBlocks);
+}
+
+
+void
+MemoryPool_FreeBlockRemotely(struct MemoryPool *self, void *block)
 {
     assert(self != NULL);
     assert(block != NULL);
-    struct MemoryChunk *chunk = LocateMemoryChunk(block);
+    struct MemoryChunk *chunk = LocateMemoryChunk(block, self->chunkSize);
     void **slot = block;
-    *slot = chunk->freeSlot;
-    chunk->freeSlot = slot;
+    void *remoteFreeSlot = atomic_load_explicit(&chunk->remoteFreeSlot, memory_order_relaxed);
 
-    if (++chunk->numberOfFreeSlots == 1) {
-        ListItem_Remove(&chunk->listItem);
-        List_InsertBack(&self->usableChunkListHead, &chunk->listItem);
+    do {
+        *slot = remoteFreeSlot;
+    } while (!atomic_compare_exchange_weak_explicit(&chunk->remoteFreeSlot, &remoteFreeSlot, slot
+                                                    , memory_order_acq_rel
+                                                    , memory_order_relaxed));
+
+    if (remoteFreeSlot != NULL) {
         return;
     }
 
-    if (chunk->numberOfFreeSlots < self->numberOfSlotsPerChunk) {
-        return;
+    struct MemoryChunk *pendingChunk = atomic_load_explicit(&self->pendingChunks
+                                                            , memory_order_relaxed);
+
+    do {
+        chunk->nextPendingChunk = pendingChunk;
+    } while (!atomic_compare_exchange_weak_explicit(&self->pendingChunks, &pendingChunk, chunk
+                                                    , memory_order_release
+                                                    , memory_order_relaxed));
+}
+
+
+struct MemoryPool *
+MemoryPool_GetBlockOwner(const void *block)
+{
+    assert(block != NULL);
+    struct MemoryPool *pool = LocateMemoryChunk(block, MEMORY_CHUNK_SIZE)->pool;
+    assert(pool->chunkSize == MEMORY_CHUNK_SIZE);
+    return pool;
+}
+
+
+int
+MemoryPool_GetSparsestChunks(const struct MemoryPool *self, int maxNumberOfChunks
+                             , const struct MemoryChunk **chunks)
+{
+    assert(self != NULL);
+    assert(maxNumberOfChunks >= 0);
+    assert(chunks != NULL || maxNumberOfChunks == 0);
+    int numberOfChunks = 0;
+    int i;
+
+    for (i = EMPTY_CHUNK_LIST_INDEX - 1; i > FULL_CHUNK_LIST_INDEX; --i) {
+        const struct ListItem *chunkListItem;
+
+        FOR_EACH_LIST_ITEM(chunkListItem, &self->chunkListHeads[i]) {
+            if (numberOfChunks == maxNumberOfChunks) {
+                return numberOfChunks;
+            }
+
+            chunks[numberOfChunks++] = CONTAINER_OF(chunkListItem, struct MemoryChunk, listItem);
+        }
     }
 
-    struct ListItem *chunkListItemPrev = ListItem_GetPrev(&chunk->listItem);
+    return numberOfChunks;
+}
+
 
-    if (chunkListItemPrev == &self->usableChunkListHead) {
-        return;
+const struct MemoryChunk *
+MemoryPool_GetBlockChunk(const struct MemoryPool *self, const void *block)
+{
+    assert(self != NULL);
+    assert(block != NULL);
+    return LocateMemoryChunk(block, self->chunkSize);
+}
+
+
+void
+MemoryPool_GetStatistics(const struct MemoryPool *self, struct MemoryPoolStatistics *statistics)
+{
+    assert(self != NULL);
+    assert(statistics != NULL);
+    memset(statistics, 0, sizeof *statistics);
+    statistics->blockSize = self->blockSize;
+    statistics->chunkSize = self->chunkSize;
+    statistics->numberOfSlotsPerChunk = self->numberOfSlotsPerChunk;
+#ifdef MEMORY_POOL_STATISTICS
+    statistics->counters = self->counters;
+#endif
+    int i;
+
+    for (i = 0; i < NUMBER_OF_CHUNK_LISTS; ++i) {
+        const struct ListItem *chunkListItem;
+
+        FOR_EACH_LIST_ITEM(chunkListItem, &self->chunkListHeads[i]) {
+            struct MemoryChunk *chunk = CONTAINER_OF(chunkListItem, struct MemoryChunk, listItem);
+            int numberOfUsedSlots = self->numberOfSlotsPerChunk - chunk->numberOfFreeSlots;
+            int j = (long long)numberOfUsedSlots * MEMORY_POOL_OCCUPANCY_HISTOGRAM_SIZE
+                    / self->numberOfSlotsPerChunk;
+
+            if (j == MEMORY_POOL_OCCUPANCY_HISTOGRAM_SIZE) {
+                --j;
+            }
+
+            ++statistics->numberOfChunks;
+            statistics->numberOfLiveBlocks += numberOfUsedSlots;
+            statistics->numberOfFreeSlots += chunk->numberOfFreeSlots;
+            ++statistics->occupancyHistogram[j];
+        }
     }
+}
 
-    struct MemoryChunk *chunkPrev = CONTAINER_OF(chunkListItemPrev, struct MemoryChunk, listItem);
 
-    if (chunkPrev->numberOfFreeSlots == self->numberOfSlotsPerChunk) {
-        return;
+void
+MemoryPool_ReportAllStatistics(void (*callback)(const struct MemoryPool *
+                                                , const struct MemoryPoolStatistics *, void *)
+                               , void *context)
+{
+    assert(callback != NULL);
+#ifdef MEMORY_POOL_STATISTICS
+    pthread_mutex_lock(&RegistryMutex);
+    struct ListItem *listItem;
+
+    FOR_EACH_LIST_ITEM(listItem, &RegistryListHead) {
+        struct MemoryPool *pool = CONTAINER_OF(listItem, struct MemoryPool, listItem);
+        struct MemoryPoolStatistics statistics;
+        MemoryPool_GetStatistics(pool, &statistics);
+        callback(pool, &statistics, context);
     }
 
-    ListItem_Remove(&chunk->listItem);
-    List_InsertFront(&self->usableChunkListHead, &chunk->listItem);
+    pthread_mutex_unlock(&RegistryMutex);
+#else
+    (void)callback;
+    (void)context;
+#endif
+}
+
+
+static void
+MemoryPool_LayOutChunks(struct MemoryPool *self)
+{
+    size_t chunkHeaderSize = sizeof(struct MemoryChunk);
+    int numberOfSlotsPerChunk = (self->chunkSize - chunkHeaderSize) / self->blockSize;
+
+    if (self->usesBitmap) {
+        for (;;) {
+            chunkHeaderSize = sizeof(struct MemoryChunk)
+                              + NUMBER_OF_BITMAP_WORDS(numberOfSlotsPerChunk) * sizeof(uint64_t);
+
+            if (chunkHeaderSize + numberOfSlotsPerChunk * self->blockSize <= self->chunkSize) {
+                break;
+            }
+
+            --numberOfSlotsPerChunk;
+        }
+    }
+
+    assert(numberOfSlotsPerChunk >= 1);
+    self->chunkHeaderSize = chunkHeaderSize;
+    self->numberOfSlotsPerChunk = numberOfSlotsPerChunk;
+    /*
+     * The slack left behind the slots of a chunk is used to shift its blocks by a varying number
+     * of cache lines, so that blocks of the same index in different chunks do not all map to the
+     * same cache sets.
+     */
+    size_t slackSize = self->chunkSize - chunkHeaderSize - numberOfSlotsPerChunk * self->blockSize;
+    self->numberOfChunkColors = self->colorsChunks
+                                ? slackSize / MemoryPool_GetChunkColorSpacing(self) + 1 : 1;
+    self->nextChunkColor = 0;
+}
+
+
+static size_t
+MemoryPool_GetChunkColorSpacing(const struct MemoryPool *self)
+{
+    /*
+     * Blocks aligned beyond a cache line by their size are shifted by multiples of that
+     * alignment, so as to keep it.
+     */
+    size_t blockAlignment = self->blockSize & -self->blockSize;
+    return blockAlignment > CACHE_LINE_SIZE ? blockAlignment : CACHE_LINE_SIZE;
+}
+
+
+static struct MemoryChunk *
+MemoryPool_GetUsableChunk(struct MemoryPool *self)
+{
+    /*
+     * The lowest set bit past the full chunk list picks the fullest usable chunk, falling back on
+     * empty chunks.
+     */
+    unsigned int usableChunkListMask = self->chunkListMask & ~(1u << FULL_CHUNK_LIST_INDEX);
+
+    if (usableChunkListMask == 0) {
+        MemoryPool_CollectRemoteFreeBlocks(self);
+        usableChunkListMask = self->chunkListMask & ~(1u << FULL_CHUNK_LIST_INDEX);
+
+        if (usableChunkListMask == 0) {
+            if (!MemoryPool_IncreaseChunks(self)) {
+                return NULL;
+            }
+
+            usableChunkListMask = 1u << EMPTY_CHUNK_LIST_INDEX;
+        }
+    }
+
+    return CONTAINER_OF(List_GetBack(&self->chunkListHeads[__builtin_ctz(usableChunkListMask)])
+                        , struct MemoryChunk, listItem);
 }
 
 
 static bool
 MemoryPool_IncreaseChunks(struct MemoryPool *self)
 {
-    struct MemoryChunk *chunk;
-    int errorNumber = posix_memalign((void **)&chunk, MEMORY_CHUNK_SIZE, MEMORY_CHUNK_SIZE);
+    struct MemoryChunk *chunk = self->chunkProvider->allocateChunk(self->chunkProvider
+                                                                   , self->chunkSize);
 
-    if (errorNumber != 0) {
-        assert(errorNumber != EINVAL);
+    if (chunk == NULL) {
         return false;
     }
 
-    void *block = (char *)chunk + MEMORY_CHUNK_SIZE - self->blockSize;
-    void **slot = block;
-    chunk->freeSlot = slot;
+    MEMORY_POOL_COUNT(self, numberOfChunkAcquisitions, 1);
+    chunk->pool = self;
+    chunk->freeSlot = NULL;
+    chunk->colorOffset = self->nextChunkColor * MemoryPool_GetChunkColorSpacing(self);
+    self->nextChunkColor = (self->nextChunkColor + 1) % self->numberOfChunkColors;
+    chunk->nextUncarvedBlock = MemoryPool_LocateFirstBlock(self, chunk);
+    chunk->numberOfFreeSlots = self->numberOfSlotsPerChunk;
+    chunk->emptyTime = 0;
+    atomic_init(&chunk->remoteFreeSlot, NULL);
 
-    for (;;) {
-        block = (char *)block - self->blockSize;
+    if (self->usesBitmap) {
+        int numberOfBitmapWords = NUMBER_OF_BITMAP_WORDS(self->numberOfSlotsPerChunk);
+        int i;
 
-        if (block < (void *)(chunk + 1)) {
-            break;
+        for (i = 0; i < numberOfBitmapWords; ++i) {
+            chunk->bitmap[i] = ~(uint64_t)0;
         }
 
-        *slot = block;
-        slot = block;
+        chunk->bitmap[numberOfBitmapWords - 1] >>= numberOfBitmapWords * BITMAP_WORD_WIDTH
+                                                  - self->numberOfSlotsPerChunk;
+        chunk->bitmapHint = 0;
     }
 
-    *slot = NULL;
-    chunk->numberOfFreeSlots = self->numberOfSlotsPerChunk;
-    List_InsertFront(&self->usableChunkListHead, &chunk->listItem);
+    MemoryPool_FileChunk(self, chunk);
     return true;
 }
 
 
+static void **
+MemoryPool_TakeSlot(const struct MemoryPool *self, struct MemoryChunk *chunk)
+{
+    if (self->usesBitmap) {
+        int i = chunk->bitmapHint;
+
+        while (chunk->bitmap[i] == 0) {
+            ++i;
+        }
+
+        chunk->bitmapHint = i;
+        int j = i * BITMAP_WORD_WIDTH + __builtin_ctzll(chunk->bitmap[i]);
+        chunk->bitmap[i] &= chunk->bitmap[i] - 1;
+        char *block = MemoryPool_LocateFirstBlock(self, chunk) - j * self->blockSize;
+
+        if (block <= chunk->nextUncarvedBlock) {
+            chunk->nextUncarvedBlock = block - self->blockSize;
+        }
+
+        return (void **)block;
+    }
+
+    void **slot = chunk->freeSlot;
+
+    if (slot == NULL) {
+        slot = (void **)chunk->nextUncarvedBlock;
+        chunk->nextUncarvedBlock -= self->blockSize;
+    } else {
+        chunk->freeSlot = *slot;
+    }
+
+    return slot;
+}
+
+
+static void
+MemoryPool_PutSlots(struct MemoryPool *self, struct MemoryChunk *chunk, void **firstSlot
+                    , void **lastSlot, int numberOfSlots)
+{
+    if (self->usesBitmap) {
+        char *firstBlock = MemoryPool_LocateFirstBlock(self, chunk);
+        void **slot = firstSlot;
+
+        for (;;) {
+            int j = (firstBlock - (char *)slot) / self->blockSize;
+            int i = j / BITMAP_WORD_WIDTH;
+            chunk->bitmap[i] |= (uint64_t)1 << j % BITMAP_WORD_WIDTH;
+
+            if (i < chunk->bitmapHint) {
+                chunk->bitmapHint = i;
+            }
+
+            if (slot == lastSlot) {
+                break;
+            }
+
+            slot = *slot;
+        }
+    } else {
+        *lastSlot = chunk->freeSlot;
+        chunk->freeSlot = firstSlot;
+    }
+
+    int numberOfFreeSlots = chunk->numberOfFreeSlots;
+    chunk->numberOfFreeSlots += numberOfSlots;
+
+    if (chunk->numberOfFreeSlots == self->numberOfSlotsPerChunk
+        && self->maxNumberOfRetainedChunks >= 0) {
+        chunk->emptyTime = GetTime();
+    }
+
+    MemoryPool_RefileChunk(self, chunk, numberOfFreeSlots);
+}
+
+
+static void
+MemoryPool_PutBlocks(struct MemoryPool *self, int numberOfBlocks, void *const *blocks)
+{
+    /*
+     * Blocks are chained into one batch per chunk, wherever they lie in the array, and each
+     * batch is given back to its chunk at once. Batches are given back early whenever they
+     * would outnumber `MAX_NUMBER_OF_CHUNK_BATCHES`.
+     */
+    struct MemoryChunkBatch batches[MAX_NUMBER_OF_CHUNK_BATCHES];
+    int numberOfBatches = 0;
+    int k = 0;
+    int i;
+
+    for (i = 0; i < numberOfBlocks; ++i) {
+        struct MemoryChunk *chunk = LocateMemoryChunk(blocks[i], self->chunkSize);
+        void **slot = blocks[i];
+
+        if (k >= numberOfBatches || batches[k].chunk != chunk) {
+            k = 0;
+
+            while (k < numberOfBatches && batches[k].chunk != chunk) {
+                ++k;
+            }
+
+            if (k == numberOfBatches) {
+                if (numberOfBatches == MAX_NUMBER_OF_CHUNK_BATCHES) {
+                    MemoryPool_PutChunkBatches(self, batches, numberOfBatches);
+                    k = numberOfBatches = 0;
+                }
+
+                batches[numberOfBatches++] = (struct MemoryChunkBatch) {chunk, slot, slot, 1};
+                continue;
+            }
+        }
+
+        *batches[k].lastSlot = slot;
+        batches[k].lastSlot = slot;
+        ++batches[k].numberOfSlots;
+    }
+
+    MemoryPool_PutChunkBatches(self, batches, numberOfBatches);
+}
+
+
+static void
+MemoryPool_PutChunkBatches(struct MemoryPool *self, const struct MemoryChunkBatch *batches
+                           , int numberOfBatches)
+{
+    int i;
+
+    for (i = 0; i < numberOfBatches; ++i) {
+        MemoryPool_PutSlots(self, batches[i].chunk, batches[i].firstSlot, batches[i].lastSlot
+                            , batches[i].numberOfSlots);
+    }
+}
+
+
+static int
+MemoryPool_GetChunkListIndex(const struct MemoryPool *self, int numberOfFreeSlots)
+{
+    if (numberOfFreeSlots == 0) {
+        return FULL_CHUNK_LIST_INDEX;
+    }
+
+    if (numberOfFreeSlots == self->numberOfSlotsPerChunk) {
+        return EMPTY_CHUNK_LIST_INDEX;
+    }
+
+    return 1 + (long long)numberOfFreeSlots * MEMORY_POOL_NUMBER_OF_OCCUPANCY_BUCKETS
+               / self->numberOfSlotsPerChunk;
+}
+
+
+static void
+MemoryPool_FileChunk(struct MemoryPool *self, struct MemoryChunk *chunk)
+{
+    int i = MemoryPool_GetChunkListIndex(self, chunk->numberOfFreeSlots);
+    List_InsertBack(&self->chunkListHeads[i], &chunk->listItem);
+    self->chunkListMask |= 1u << i;
+}
+
+
+static void
+MemoryPool_UnfileChunk(struct MemoryPool *self, struct MemoryChunk *chunk, int numberOfFreeSlots)
+{
+    int i = MemoryPool_GetChunkListIndex(self, numberOfFreeSlots);
+    ListItem_Remove(&chunk->listItem);
+
+    if (List_IsEmpty(&self->chunkListHeads[i])) {
+        self->chunkListMask &= ~(1u << i);
+    }
+}
+
+
+static void
+MemoryPool_RefileChunk(struct MemoryPool *self, struct MemoryChunk *chunk
+                       , int oldNumberOfFreeSlots)
+{
+    if (MemoryPool_GetChunkListIndex(self, oldNumberOfFreeSlots)
+        == MemoryPool_GetChunkListIndex(self, chunk->numberOfFreeSlots)) {
+        return;
+    }
+
+    MemoryPool_UnfileChunk(self, chunk, oldNumberOfFreeSlots);
+    MemoryPool_FileChunk(self, chunk);
+}
+
+
+static void
+MemoryPool_CollectRemoteFreeBlocks(struct MemoryPool *self)
+{
+    if (atomic_load_explicit(&self->pendingChunks, memory_order_relaxed) == NULL) {
+        return;
+    }
+
+    struct MemoryChunk *chunk = atomic_exchange_explicit(&self->pendingChunks, NULL
+                                                         , memory_order_acquire);
+
+    do {
+        struct MemoryChunk *nextChunk = chunk->nextPendingChunk;
+        void **slot = atomic_exchange_explicit(&chunk->remoteFreeSlot, NULL
+                                               , memory_order_acq_rel);
+
+        do {
+            void **nextSlot = *slot;
+            MemoryPool_FreeBlock(self, slot);
+            slot = nextSlot;
+        } while (slot != NULL);
+
+        chunk = nextChunk;
+    } while (chunk != NULL);
+}
+
+
+static char *
+MemoryPool_LocateFirstBlock(const struct MemoryPool *self, const struct MemoryChunk *chunk)
+{
+    return (char *)chunk + self->chunkSize - chunk->colorOffset - self->blockSize;
+}
+
+
+static void
+MemoryPool_TrimChunk(const struct MemoryPool *self, struct MemoryChunk *chunk)
+{
+    size_t pageSize = sysconf(_SC_PAGESIZE);
+    char *payload = (char *)(((uintptr_t)chunk + self->chunkHeaderSize + pageSize - 1)
+                             & ~(pageSize - 1));
+#if defined MEMORY_POOL_TRIM_WITH_MADV_FREE && defined MADV_FREE
+    madvise(payload, (char *)chunk + self->chunkSize - payload, MADV_FREE);
+#else
+    madvise(payload, (char *)chunk + self->chunkSize - payload, MADV_DONTNEED);
+#endif
+    chunk->freeSlot = NULL;
+    chunk->nextUncarvedBlock = MemoryPool_LocateFirstBlock(self, chunk);
+}
+
+
+static bool
+MemoryPool_ChunkIsTrimmed(const struct MemoryPool *self, const struct MemoryChunk *chunk)
+{
+    /*
+     * An empty chunk with nothing carved out of it has not been touched since it was trimmed (or
+     * acquired), so there is nothing to release.
+     */
+    return chunk->freeSlot == NULL
+           && chunk->nextUncarvedBlock == MemoryPool_LocateFirstBlock(self, chunk);
+}
+
+
 static struct MemoryChunk *
-LocateMemoryChunk(const void *memoryBlock)
+LocateMemoryChunk(const void *memoryBlock, size_t chunkSize)
+{
+    return (struct MemoryChunk *)((uintptr_t)memoryBlock & ~(chunkSize - 1));
+}
+
+
+static long long
+GetTime(void)
 {
-    return (struct MemoryChunk *)((uintptr_t)memoryBlock & ~(MEMORY_CHUNK_SIZE - 1));
+    struct timespec timeSpec;
+#ifdef CLOCK_MONOTONIC_COARSE
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &timeSpec);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &timeSpec);
+#endif
+    return timeSpec.tv_sec * 1000LL + timeSpec.tv_nsec / 1000000;
 }
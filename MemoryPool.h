@@ -7,21 +7,148 @@
 
 
 #include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
 
 #include "List.h"
+#include "MemoryChunkProvider.h"
 
 
+#define MEMORY_CHUNK_SIZE ((size_t)65536)
+#define MAX_MEMORY_CHUNK_SIZE ((size_t)2097152)
+#define MEMORY_POOL_OCCUPANCY_HISTOGRAM_SIZE 10
+#define MEMORY_POOL_NUMBER_OF_OCCUPANCY_BUCKETS 8
+
+
+struct MemoryChunk;
+
+
+/*
+ * Event counters are only maintained when built with `MEMORY_POOL_STATISTICS` defined, in which
+ * case pools are also enrolled in the registry walked by `MemoryPool_ReportAllStatistics`.
+ */
+struct MemoryPoolCounters
+{
+    unsigned long long numberOfAllocations;
+    unsigned long long numberOfFrees;
+    unsigned long long numberOfChunkAcquisitions;
+    unsigned long long numberOfChunkReleases;
+    unsigned long long numberOfChunkTrims;
+    long numberOfLiveBlocks;
+    long peakNumberOfLiveBlocks;
+};
+
+
+struct MemoryPoolStatistics
+{
+    size_t blockSize;
+    size_t chunkSize;
+    int numberOfSlotsPerChunk;
+    int numberOfChunks;
+    long numberOfLiveBlocks;
+    long numberOfFreeSlots;
+    struct MemoryPoolCounters counters;
+    int occupancyHistogram[MEMORY_POOL_OCCUPANCY_HISTOGRAM_SIZE];
+};
+
+
+/*
+ * Chunks are filed by occupancy: full chunks, partially used chunks in buckets of decreasing
+ * occupancy, then empty chunks. Blocks are allocated from the fullest usable chunk, so sparse
+ * chunks are left to drain.
+ */
 struct MemoryPool
 {
     size_t blockSize;
+    size_t chunkSize;
+    struct MemoryChunkProvider *chunkProvider;
+    bool usesBitmap;
+    bool colorsChunks;
+    size_t chunkHeaderSize;
     int numberOfSlotsPerChunk;
-    struct ListItem usableChunkListHead;
-    struct ListItem unusableChunkListHead;
+    int numberOfChunkColors;
+    int nextChunkColor;
+    int maxNumberOfRetainedChunks;
+    long chunkDecayTime;
+    unsigned int chunkListMask;
+    struct ListItem chunkListHeads[MEMORY_POOL_NUMBER_OF_OCCUPANCY_BUCKETS + 2];
+    _Atomic(struct MemoryChunk *) pendingChunks;
+#ifdef MEMORY_POOL_STATISTICS
+    struct ListItem listItem;
+    struct MemoryPoolCounters counters;
+#endif
 };
 
 
+extern const size_t MemoryChunkPayloadSize;
+
+
+/*
+ * Blocks are aligned to the largest power of two dividing the block size, up to the chunk size.
+ */
 void MemoryPool_Initialize(struct MemoryPool *, size_t);
 void MemoryPool_Finalize(const struct MemoryPool *);
+void MemoryPool_SetChunkSize(struct MemoryPool *, size_t);
+void MemoryPool_SetChunkProvider(struct MemoryPool *, struct MemoryChunkProvider *);
+
+/*
+ * Once set, `MemoryPool_ShrinkToFit` no longer frees empty chunks. It keeps up to the given
+ * number of them resident, as long as they have been empty for less than the decay time (in
+ * milliseconds), and releases the physical memory of the others with madvise(2) while keeping
+ * their address ranges. Decay is thus applied whenever the pool is shrunk.
+ */
+void MemoryPool_SetChunkRetention(struct MemoryPool *, int, long);
+
+/*
+ * Tracks the occupancy of each chunk with a bitmap in its header instead of the intrusive free
+ * list, which makes live blocks enumerable. `MemoryPool_ForEachLiveBlock` may only be called on
+ * such pools; its callback may free the block it is given, but nothing else of the pool.
+ */
+void MemoryPool_EnableBitmap(struct MemoryPool *);
+void MemoryPool_ForEachLiveBlock(struct MemoryPool *, void (*)(void *, void *), void *);
+
+/*
+ * Stops shifting the blocks of successive chunks by varying numbers of cache lines (see
+ * bench/MemoryPoolColoringBenchmark.c), which is otherwise done with the slack of each chunk.
+ */
+void MemoryPool_DisableChunkColoring(struct MemoryPool *);
+
 void MemoryPool_ShrinkToFit(struct MemoryPool *);
 void *MemoryPool_AllocateBlock(struct MemoryPool *);
 void MemoryPool_FreeBlock(struct MemoryPool *, void *);
+bool MemoryPool_AllocateBlocks(struct MemoryPool *, int, void **);
+
+/*
+ * Blocks are grouped by chunk, in any order, and each group is given back to its chunk at once.
+ */
+void MemoryPool_FreeBlocks(struct MemoryPool *, int, void *const *);
+
+/*
+ * Fills in up to the given number of the sparsest partially used chunks, sparsest first, and
+ * returns how many have been found. Callers able to relocate objects may move the blocks lying
+ * in these chunks (see `MemoryPool_GetBlockChunk`) elsewhere, so that the chunks can be released.
+ */
+int MemoryPool_GetSparsestChunks(const struct MemoryPool *, int, const struct MemoryChunk **);
+const struct MemoryChunk *MemoryPool_GetBlockChunk(const struct MemoryPool *, const void *);
+
+void MemoryPool_GetStatistics(const struct MemoryPool *, struct MemoryPoolStatistics *);
+
+/*
+ * The callback runs with the registry locked; it must not initialize or finalize pools, and the
+ * caller is responsible for keeping the reported pools quiescent.
+ */
+void MemoryPool_ReportAllStatistics(void (*)(const struct MemoryPool *
+                                             , const struct MemoryPoolStatistics *, void *)
+                                    , void *);
+
+/*
+ * Only applicable to blocks of pools with the default chunk size.
+ */
+struct MemoryPool *MemoryPool_GetBlockOwner(const void *);
+
+/*
+ * May be called from any thread, concurrently with the owner of the pool. The block is pushed
+ * onto a lock-free list of its chunk and reclaimed by the owner once it runs out of usable
+ * chunks (or shrinks the pool).
+ */
+void MemoryPool_FreeBlockRemotely(struct MemoryPool *, void *);
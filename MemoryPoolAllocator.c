@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+#include "MemoryPoolAllocator.h"
+
+#include <stddef.h>
+#include <assert.h>
+
+#include "MemoryPool.h"
+#include "Utility.h"
+
+
+static void *MemoryPoolAllocator_Allocate(struct Allocator *, size_t);
+static void *MemoryPoolAllocator_Reallocate(struct Allocator *, void *, size_t, size_t);
+static void MemoryPoolAllocator_Free(struct Allocator *, void *, size_t);
+
+
+void
+MemoryPoolAllocator_Initialize(struct MemoryPoolAllocator *self, struct MemoryPool *memoryPool)
+{
+    assert(self != NULL);
+    assert(memoryPool != NULL);
+    self->allocator.allocate = MemoryPoolAllocator_Allocate;
+    self->allocator.reallocate = MemoryPoolAllocator_Reallocate;
+    self->allocator.free = MemoryPoolAllocator_Free;
+    self->memoryPool = memoryPool;
+}
+
+
+static void *
+MemoryPoolAllocator_Allocate(struct Allocator *allocator, size_t size)
+{
+    struct MemoryPoolAllocator *self = CONTAINER_OF(allocator, struct MemoryPoolAllocator
+                                                    , allocator);
+
+    if (size > self->memoryPool->blockSize) {
+        return NULL;
+    }
+
+    return MemoryPool_AllocateBlock(self->memoryPool);
+}
+
+
+static void *
+MemoryPoolAllocator_Reallocate(struct Allocator *allocator, void *block, size_t oldSize
+                               , size_t size)
+{
+    struct MemoryPoolAllocator *self = CONTAINER_OF(allocator, struct MemoryPoolAllocator
+                                                    , allocator);
+    (void)oldSize;
+
+    if (block == NULL) {
+        return MemoryPoolAllocator_Allocate(allocator, size);
+    }
+
+    if (size > self->memoryPool->blockSize) {
+        return NULL;
+    }
+
+    return block;
+}
+
+
+static void
+MemoryPoolAllocator_Free(struct Allocator *allocator, void *block, size_t size)
+{
+    struct MemoryPoolAllocator *self = CONTAINER_OF(allocator, struct MemoryPoolAllocator
+                                                    , allocator);
+    (void)size;
+
+    if (block == NULL) {
+        return;
+    }
+
+    MemoryPool_FreeBlock(self->memoryPool, block);
+}
@@ -0,0 +1,25 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+#pragma once
+
+
+#include "Allocator.h"
+
+
+struct MemoryPool;
+
+
+/*
+ * Hands out the blocks of a memory pool, hence only serves sizes up to its block size.
+ */
+struct MemoryPoolAllocator
+{
+    struct Allocator allocator;
+    struct MemoryPool *memoryPool;
+};
+
+
+void MemoryPoolAllocator_Initialize(struct MemoryPoolAllocator *, struct MemoryPool *);
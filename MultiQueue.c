@@ -0,0 +1,226 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+#include "MultiQueue.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <time.h>
+
+
+#define CACHE_LINE_SIZE 64
+
+
+struct MultiQueueShard
+{
+    atomic_bool isLocked;
+    struct Heap heap;
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+
+static struct MultiQueueShard *MultiQueue_LockRandomShard(struct MultiQueue *);
+static void MultiQueue_LockRandomShards(struct MultiQueue *, struct MultiQueueShard **
+                                        , struct MultiQueueShard **);
+static struct MultiQueueShard *MultiQueue_TryLockRandomShard(struct MultiQueue *
+                                                             , const struct MultiQueueShard *);
+static bool MultiQueueShard_TryLock(struct MultiQueueShard *);
+static void MultiQueueShard_Unlock(struct MultiQueueShard *);
+static uint64_t DrawRandomNumber(void);
+
+
+static __thread uint64_t RandomState __attribute__((tls_model("initial-exec")));
+
+
+bool
+MultiQueue_Initialize(struct MultiQueue *self, int numberOfShards)
+{
+    assert(self != NULL);
+    assert(numberOfShards >= 1);
+    void *shards;
+
+    if (posix_memalign(&shards, CACHE_LINE_SIZE, numberOfShards
+                                                 * sizeof(struct MultiQueueShard)) != 0) {
+        return false;
+    }
+
+    self->shards = shards;
+    self->numberOfShards = numberOfShards;
+    int i;
+
+    for (i = 0; i < numberOfShards; ++i) {
+        atomic_init(&self->shards[i].isLocked, false);
+        Heap_Initialize(&self->shards[i].heap);
+    }
+
+    atomic_init(&self->numberOfNodes, 0);
+    return true;
+}
+
+
+void
+MultiQueue_Finalize(const struct MultiQueue *self)
+{
+    assert(self != NULL);
+    int i;
+
+    for (i = 0; i < self->numberOfShards; ++i) {
+        Heap_Finalize(&self->shards[i].heap);
+    }
+
+    free(self->shards);
+}
+
+
+bool
+MultiQueue_Push(struct MultiQueue *self, struct HeapNode *node
+                , int (*nodeComparer)(const struct HeapNode *, const struct HeapNode *))
+{
+    assert(self != NULL);
+    assert(node != NULL);
+    assert(nodeComparer != NULL);
+    struct MultiQueueShard *shard = MultiQueue_LockRandomShard(self);
+    bool nodeIsInserted = Heap_InsertNode(&shard->heap, node, nodeComparer);
+    MultiQueueShard_Unlock(shard);
+
+    if (!nodeIsInserted) {
+        return false;
+    }
+
+    atomic_fetch_add_explicit(&self->numberOfNodes, 1, memory_order_relaxed);
+    return true;
+}
+
+
+struct HeapNode *
+MultiQueue_Pop(struct MultiQueue *self
+               , int (*nodeComparer)(const struct HeapNode *, const struct HeapNode *))
+{
+    assert(self != NULL);
+    assert(nodeComparer != NULL);
+
+    /*
+     * Nodes are counted after being pushed and after being popped, so the count being zero
+     * means that the queue is empty at that time.
+     */
+    while (atomic_load_explicit(&self->numberOfNodes, memory_order_relaxed) >= 1) {
+        struct MultiQueueShard *shard1;
+        struct MultiQueueShard *shard2;
+        MultiQueue_LockRandomShards(self, &shard1, &shard2);
+        struct HeapNode *top1 = Heap_GetTop(&shard1->heap);
+        struct HeapNode *top2 = Heap_GetTop(&shard2->heap);
+        struct MultiQueueShard *shard = shard1;
+
+        if (top1 == NULL || (top2 != NULL && nodeComparer(top2, top1) < 0)) {
+            shard = shard2;
+        }
+
+        struct HeapNode *node = NULL;
+
+        if (Heap_GetTop(&shard->heap) != NULL) {
+            node = Heap_PopTop(&shard->heap, nodeComparer);
+        }
+
+        MultiQueueShard_Unlock(shard1);
+
+        if (shard2 != shard1) {
+            MultiQueueShard_Unlock(shard2);
+        }
+
+        if (node != NULL) {
+            atomic_fetch_sub_explicit(&self->numberOfNodes, 1, memory_order_relaxed);
+            return node;
+        }
+    }
+
+    return NULL;
+}
+
+
+static struct MultiQueueShard *
+MultiQueue_LockRandomShard(struct MultiQueue *self)
+{
+    /*
+     * Shards taken are skipped rather than waited for.
+     */
+    for (;;) {
+        struct MultiQueueShard *shard = MultiQueue_TryLockRandomShard(self, NULL);
+
+        if (shard != NULL) {
+            return shard;
+        }
+    }
+}
+
+
+static void
+MultiQueue_LockRandomShards(struct MultiQueue *self, struct MultiQueueShard **shard1
+                            , struct MultiQueueShard **shard2)
+{
+    /*
+     * A shard is never held while waiting for another, lest threads holding a shard wait for
+     * each other: when the second shard is taken, the first one is let go and both are drawn
+     * again, so that pops always choose between two shards.
+     */
+    for (;;) {
+        *shard1 = MultiQueue_LockRandomShard(self);
+
+        if (self->numberOfShards == 1) {
+            *shard2 = *shard1;
+            return;
+        }
+
+        *shard2 = MultiQueue_TryLockRandomShard(self, *shard1);
+
+        if (*shard2 != NULL) {
+            return;
+        }
+
+        MultiQueueShard_Unlock(*shard1);
+    }
+}
+
+
+static struct MultiQueueShard *
+MultiQueue_TryLockRandomShard(struct MultiQueue *self, const struct MultiQueueShard *otherShard)
+{
+    struct MultiQueueShard *shard = &self->shards[DrawRandomNumber() % self->numberOfShards];
+
+    if (shard == otherShard) {
+        shard = &self->shards[(shard - self->shards + 1) % self->numberOfShards];
+    }
+
+    return MultiQueueShard_TryLock(shard) ? shard : NULL;
+}
+
+
+static bool
+MultiQueueShard_TryLock(struct MultiQueueShard *self)
+{
+    return !atomic_load_explicit(&self->isLocked, memory_order_relaxed)
+           && !atomic_exchange_explicit(&self->isLocked, true, memory_order_acquire);
+}
+
+
+static void
+MultiQueueShard_Unlock(struct MultiQueueShard *self)
+{
+    atomic_store_explicit(&self->isLocked, false, memory_order_release);
+}
+
+
+static uint64_t
+DrawRandomNumber(void)
+{
+    if (RandomState == 0) {
+        RandomState = ((uint64_t)(uintptr_t)&RandomState ^ (uint64_t)time(NULL)) | 1;
+    }
+
+    RandomState ^= RandomState << 13;
+    RandomState ^= RandomState >> 7;
+    RandomState ^= RandomState << 17;
+    return RandomState;
+}
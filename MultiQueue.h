@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+#pragma once
+
+
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#include "Heap.h"
+
+
+struct MultiQueueShard;
+
+
+/*
+ * A relaxed concurrent priority queue made of heap shards, each guarded by a try-lock, whose
+ * number is best a small multiple (2 to 4) of the number of threads. Nodes are pushed into random
+ * shards, and popped from the better of the tops of two random shards.
+ *
+ * Guarantees:
+ *   - every node pushed is popped exactly once;
+ *   - a pop returns NULL only if the queue was empty at some point during the call;
+ *   - a node popped is the top of its shard, so nodes pushed into the same shard are popped in
+ *     order, yet across shards the order is relaxed: the rank of a node popped among all the
+ *     nodes is expected to be linear in the number of shards, with an exponentially decaying
+ *     tail, and no bound holds in the worst case. Shards held by threads that get descheduled
+ *     are passed over meanwhile, so with more threads than processors ranks grow much larger
+ *     (see bench/MultiQueueBenchmark.c).
+ */
+struct MultiQueue
+{
+    struct MultiQueueShard *shards;
+    int numberOfShards;
+    atomic_long numberOfNodes;
+};
+
+
+bool MultiQueue_Initialize(struct MultiQueue *, int);
+void MultiQueue_Finalize(const struct MultiQueue *);
+bool MultiQueue_Push(struct MultiQueue *, struct HeapNode *, int (*)(const struct HeapNode *
+                                                                     , const struct HeapNode *));
+struct HeapNode *MultiQueue_Pop(struct MultiQueue *, int (*)(const struct HeapNode *
+                                                             , const struct HeapNode *));
@@ -5,12 +5,9 @@
 
 #include "RBTree.h"
 
-#include <stddef.h>
-#include <assert.h>
 #include <stdbool.h>
 
 
-static void RBTree_FixNodeInsertion(struct RBTree *, struct RBTreeNode *);
 static void RBTree_FixNodeRemoval(struct RBTree *, struct RBTreeNode *);
 static void RBTree_RotateNodeLeft(struct RBTree *, struct RBTreeNode *);
 static void RBTree_RotateNodeRight(struct RBTree *, struct RBTreeNode *);
@@ -32,25 +29,7 @@ RBTree_InsertNode(struct RBTree *self, struct RBTreeNode *node
     assert(self != NULL);
     assert(node != NULL);
     assert(nodeComparer != NULL);
-    struct RBTreeNode *nodeParent = &self->nil;
-    struct RBTreeNode **nodeParentChild = &self->root;
-
-    while (*nodeParentChild != &self->nil) {
-        nodeParent = *nodeParentChild;
-
-        if (nodeComparer(node, nodeParent) < 0) {
-            nodeParentChild = &nodeParent->leftChild;
-        } else {
-            nodeParentChild = &nodeParent->rightChild;
-        }
-    }
-
-    *nodeParentChild = node;
-    node->parent = nodeParent;
-    node->leftChild = &self->nil;
-    node->rightChild = &self->nil;
-    node->color = RBTreeNodeRed;
-    RBTree_FixNodeInsertion(self, node);
+    __RBTree_InsertNode(self, node, nodeComparer);
 }
 
 
@@ -130,23 +109,7 @@ RBTree_Search(const struct RBTree *self, uintptr_t key, int (*nodeMatcher)(const
 {
     assert(self != NULL);
     assert(nodeMatcher != NULL);
-    struct RBTreeNode *node = self->root;
-
-    while (node != &self->nil) {
-        int delta = nodeMatcher(node, key);
-
-        if (delta == 0) {
-            return node;
-        }
-
-        if (delta < 0) {
-            node = node->rightChild;
-        } else {
-            node = node->leftChild;
-        }
-    }
-
-    return NULL;
+    return __RBTree_Search(self, key, nodeMatcher);
 }
 
 
@@ -186,8 +149,8 @@ RBTree_FindMax(const struct RBTree *self)
 }
 
 
-static void
-RBTree_FixNodeInsertion(struct RBTree *self, struct RBTreeNode *node)
+void
+__RBTree_FixNodeInsertion(struct RBTree *self, struct RBTreeNode *node)
 {
     struct RBTreeNode *nodeParent = node->parent;
 
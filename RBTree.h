@@ -6,7 +6,60 @@
 #pragma once
 
 
+#include <stddef.h>
 #include <stdint.h>
+#include <assert.h>
+
+#include "Utility.h"
+
+
+/*
+ * Defines counterparts of the `RBTree` functions for trees of `type` linked through `field`, with
+ * `comparer` (taking two `const type *`) and `matcher` (taking a `const type *` and a `uintptr_t`
+ * key) inlined.
+ */
+#define DEFINE_RBTREE(name, type, field, comparer, matcher)                                  \
+    static inline int                                                                        \
+    name##_CompareNodes(const struct RBTreeNode *node1, const struct RBTreeNode *node2)      \
+    {                                                                                        \
+        return comparer(CONTAINER_OF(node1, type, field), CONTAINER_OF(node2, type, field)); \
+    }                                                                                        \
+                                                                                             \
+    static inline int                                                                        \
+    name##_MatchNode(const struct RBTreeNode *node, uintptr_t key)                           \
+    {                                                                                        \
+        return matcher(CONTAINER_OF(node, type, field), key);                                \
+    }                                                                                        \
+                                                                                             \
+    static inline void                                                                       \
+    name##_InsertNode(struct RBTree *tree, type *object)                                     \
+    {                                                                                        \
+        assert(tree != NULL);                                                                \
+        assert(object != NULL);                                                              \
+        __RBTree_InsertNode(tree, &object->field, name##_CompareNodes);                      \
+    }                                                                                        \
+                                                                                             \
+    static inline type *                                                                     \
+    name##_Search(const struct RBTree *tree, uintptr_t key)                                  \
+    {                                                                                        \
+        assert(tree != NULL);                                                                \
+        struct RBTreeNode *node = __RBTree_Search(tree, key, name##_MatchNode);              \
+        return node == NULL ? NULL : CONTAINER_OF(node, type, field);                        \
+    }                                                                                        \
+                                                                                             \
+    static inline type *                                                                     \
+    name##_FindMin(const struct RBTree *tree)                                                \
+    {                                                                                        \
+        struct RBTreeNode *node = RBTree_FindMin(tree);                                      \
+        return node == NULL ? NULL : CONTAINER_OF(node, type, field);                        \
+    }                                                                                        \
+                                                                                             \
+    static inline type *                                                                     \
+    name##_FindMax(const struct RBTree *tree)                                                \
+    {                                                                                        \
+        struct RBTreeNode *node = RBTree_FindMax(tree);                                      \
+        return node == NULL ? NULL : CONTAINER_OF(node, type, field);                        \
+    }
 
 
 enum __RBTreeNodeColor
@@ -40,3 +93,60 @@ struct RBTreeNode *RBTree_Search(const struct RBTree *, uintptr_t, int (*)(const
                                                                            , uintptr_t));
 struct RBTreeNode *RBTree_FindMin(const struct RBTree *);
 struct RBTreeNode *RBTree_FindMax(const struct RBTree *);
+
+void __RBTree_FixNodeInsertion(struct RBTree *, struct RBTreeNode *);
+static inline void __RBTree_InsertNode(struct RBTree *, struct RBTreeNode *
+                                       , int (*)(const struct RBTreeNode *
+                                                 , const struct RBTreeNode *));
+static inline struct RBTreeNode *__RBTree_Search(const struct RBTree *, uintptr_t
+                                                 , int (*)(const struct RBTreeNode *, uintptr_t));
+
+
+static inline __attribute__((always_inline)) void
+__RBTree_InsertNode(struct RBTree *self, struct RBTreeNode *node
+                    , int (*nodeComparer)(const struct RBTreeNode *, const struct RBTreeNode *))
+{
+    struct RBTreeNode *nodeParent = &self->nil;
+    struct RBTreeNode **nodeParentChild = &self->root;
+
+    while (*nodeParentChild != &self->nil) {
+        nodeParent = *nodeParentChild;
+
+        if (nodeComparer(node, nodeParent) < 0) {
+            nodeParentChild = &nodeParent->leftChild;
+        } else {
+            nodeParentChild = &nodeParent->rightChild;
+        }
+    }
+
+    *nodeParentChild = node;
+    node->parent = nodeParent;
+    node->leftChild = &self->nil;
+    node->rightChild = &self->nil;
+    node->color = RBTreeNodeRed;
+    __RBTree_FixNodeInsertion(self, node);
+}
+
+
+static inline __attribute__((always_inline)) struct RBTreeNode *
+__RBTree_Search(const struct RBTree *self, uintptr_t key
+                , int (*nodeMatcher)(const struct RBTreeNode *, uintptr_t))
+{
+    struct RBTreeNode *node = self->root;
+
+    while (node != &self->nil) {
+        int delta = nodeMatcher(node, key);
+
+        if (delta == 0) {
+            return node;
+        }
+
+        if (delta < 0) {
+            node = node->rightChild;
+        } else {
+            node = node->leftChild;
+        }
+    }
+
+    return NULL;
+}
@@ -0,0 +1,293 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+#include "SizeClassAllocator.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+
+#define NUMBER_OF_TINY_SIZE_CLASSES 8
+#define NUMBER_OF_SIZE_CLASSES_PER_DOUBLING 4
+#define TINY_SIZE_CLASS_SPACING 16
+#define MAX_TINY_SIZE_CLASS_SIZE (NUMBER_OF_TINY_SIZE_CLASSES * TINY_SIZE_CLASS_SPACING)
+#define MIN_ALIGNMENT 16
+
+
+struct LargeBlockHeader
+{
+    void *mapping;
+    size_t mappingSize;
+    size_t blockSize;
+};
+
+
+static void *AllocateLargeBlock(size_t, size_t);
+static void FreeLargeBlock(void *);
+static bool IsLargeBlock(const void *);
+static struct LargeBlockHeader *LocateLargeBlockHeader(const void *);
+static int GetSizeClass(size_t);
+static size_t GetSizeClassSize(int);
+static int FloorLog2(size_t);
+
+
+void
+SizeClassAllocator_Initialize(struct SizeClassAllocator *self)
+{
+    assert(self != NULL);
+    assert(GetSizeClassSize(NUMBER_OF_SIZE_CLASSES - 1) <= MemoryChunkPayloadSize);
+    assert(GetSizeClassSize(NUMBER_OF_SIZE_CLASSES) > MemoryChunkPayloadSize);
+    int i;
+
+    for (i = 0; i < NUMBER_OF_SIZE_CLASSES; ++i) {
+        MemoryPool_Initialize(&self->pools[i], GetSizeClassSize(i));
+    }
+}
+
+
+void
+SizeClassAllocator_Finalize(const struct SizeClassAllocator *self)
+{
+    assert(self != NULL);
+    int i;
+
+    for (i = 0; i < NUMBER_OF_SIZE_CLASSES; ++i) {
+        MemoryPool_Finalize(&self->pools[i]);
+    }
+}
+
+
+void
+SizeClassAllocator_ShrinkToFit(struct SizeClassAllocator *self)
+{
+    assert(self != NULL);
+    int i;
+
+    for (i = 0; i < NUMBER_OF_SIZE_CLASSES; ++i) {
+        MemoryPool_ShrinkToFit(&self->pools[i]);
+    }
+}
+
+
+void *
+SizeClassAllocator_Allocate(struct SizeClassAllocator *self, size_t size)
+{
+    assert(self != NULL);
+
+    if (size > GetSizeClassSize(NUMBER_OF_SIZE_CLASSES - 1)) {
+        return AllocateLargeBlock(size, MEMORY_CHUNK_SIZE);
+    }
+
+    return MemoryPool_AllocateBlock(&self->pools[GetSizeClass(size)]);
+}
+
+
+void *
+SizeClassAllocator_AllocateAligned(struct SizeClassAllocator *self, size_t alignment
+                                   , size_t size)
+{
+    assert(self != NULL);
+    assert(alignment >= 1 && (alignment & (alignment - 1)) == 0);
+
+    if (alignment <= MIN_ALIGNMENT) {
+        return SizeClassAllocator_Allocate(self, size);
+    }
+
+    /*
+     * Pooled blocks are aligned to the largest power of two dividing their size (see
+     * `MemoryPool_Initialize`), so the first class whose size is a multiple of the alignment
+     * serves it. Such a class is at most a doubling away.
+     */
+    if (alignment <= (size_t)sysconf(_SC_PAGESIZE)) {
+        int sizeClass = GetSizeClass(size > alignment ? size : alignment);
+
+        while (sizeClass < NUMBER_OF_SIZE_CLASSES) {
+            if (GetSizeClassSize(sizeClass) % alignment == 0) {
+                return MemoryPool_AllocateBlock(&self->pools[sizeClass]);
+            }
+
+            ++sizeClass;
+        }
+    }
+
+    return AllocateLargeBlock(size, alignment < MEMORY_CHUNK_SIZE ? MEMORY_CHUNK_SIZE
+                                                                  : alignment);
+}
+
+
+void *
+SizeClassAllocator_Reallocate(struct SizeClassAllocator *self, void *block, size_t size)
+{
+    assert(self != NULL);
+
+    if (block == NULL) {
+        return SizeClassAllocator_Allocate(self, size);
+    }
+
+    size_t blockSize = SizeClassAllocator_GetBlockSize(block);
+
+    if (IsLargeBlock(block) ? size > GetSizeClassSize(NUMBER_OF_SIZE_CLASSES - 1)
+                              && size <= blockSize
+                            : size <= blockSize && GetSizeClass(size) == GetSizeClass(blockSize)) {
+        return block;
+    }
+
+    void *newBlock = SizeClassAllocator_Allocate(self, size);
+
+    if (newBlock == NULL) {
+        return NULL;
+    }
+
+    memcpy(newBlock, block, size < blockSize ? size : blockSize);
+    SizeClassAllocator_Free(self, block);
+    return newBlock;
+}
+
+
+void
+SizeClassAllocator_Free(struct SizeClassAllocator *self, void *block)
+{
+    assert(self != NULL);
+
+    if (block == NULL) {
+        return;
+    }
+
+    if (IsLargeBlock(block)) {
+        FreeLargeBlock(block);
+        return;
+    }
+
+    struct MemoryPool *pool = MemoryPool_GetBlockOwner(block);
+
+    if (pool >= self->pools && pool < self->pools + NUMBER_OF_SIZE_CLASSES) {
+        MemoryPool_FreeBlock(pool, block);
+    } else {
+        MemoryPool_FreeBlockRemotely(pool, block);
+    }
+}
+
+
+size_t
+SizeClassAllocator_GetBlockSize(const void *block)
+{
+    assert(block != NULL);
+
+    if (IsLargeBlock(block)) {
+        return LocateLargeBlockHeader(block)->blockSize;
+    }
+
+    return MemoryPool_GetBlockOwner(block)->blockSize;
+}
+
+
+static void *
+AllocateLargeBlock(size_t size, size_t alignment)
+{
+    size_t pageSize = sysconf(_SC_PAGESIZE);
+    size_t mappingSize = (sizeof(struct LargeBlockHeader) + alignment + size + pageSize - 1)
+                         & ~(pageSize - 1);
+
+    if (mappingSize < size) {
+        return NULL;
+    }
+
+    char *mapping = mmap(NULL, mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS
+                         , -1, 0);
+
+    if (mapping == MAP_FAILED) {
+        return NULL;
+    }
+
+    char *block = (char *)(((uintptr_t)mapping + sizeof(struct LargeBlockHeader) + alignment - 1)
+                           & ~(alignment - 1));
+    char *mappingStart = (char *)((uintptr_t)(block - sizeof(struct LargeBlockHeader))
+                                  & ~(pageSize - 1));
+    char *mappingEnd = (char *)(((uintptr_t)block + size + pageSize - 1) & ~(pageSize - 1));
+
+    if (mappingStart > mapping) {
+        munmap(mapping, mappingStart - mapping);
+    }
+
+    if (mappingEnd < mapping + mappingSize) {
+        munmap(mappingEnd, mapping + mappingSize - mappingEnd);
+    }
+
+    struct LargeBlockHeader *header = LocateLargeBlockHeader(block);
+    header->mapping = mappingStart;
+    header->mappingSize = mappingEnd - mappingStart;
+    header->blockSize = mappingEnd - block;
+    return block;
+}
+
+
+static void
+FreeLargeBlock(void *block)
+{
+    struct LargeBlockHeader *header = LocateLargeBlockHeader(block);
+    munmap(header->mapping, header->mappingSize);
+}
+
+
+static bool
+IsLargeBlock(const void *block)
+{
+    /*
+     * Pooled blocks never start a chunk (the chunk header lives there), whereas large blocks are
+     * always aligned to the chunk size.
+     */
+    return ((uintptr_t)block & (MEMORY_CHUNK_SIZE - 1)) == 0;
+}
+
+
+static struct LargeBlockHeader *
+LocateLargeBlockHeader(const void *block)
+{
+    return (struct LargeBlockHeader *)block - 1;
+}
+
+
+static int
+GetSizeClass(size_t size)
+{
+    /*
+     * Tiny classes are spaced by the minimum alignment, which all class sizes are multiples of.
+     */
+    if (size <= MAX_TINY_SIZE_CLASS_SIZE) {
+        return size == 0 ? 0 : (size - 1) / TINY_SIZE_CLASS_SPACING;
+    }
+
+    int k = FloorLog2(size - 1);
+    int m = FloorLog2(NUMBER_OF_SIZE_CLASSES_PER_DOUBLING);
+    return NUMBER_OF_TINY_SIZE_CLASSES
+           + (k - FloorLog2(MAX_TINY_SIZE_CLASS_SIZE)) * NUMBER_OF_SIZE_CLASSES_PER_DOUBLING
+           + ((size - 1 - ((size_t)1 << k)) >> (k - m));
+}
+
+
+static size_t
+GetSizeClassSize(int sizeClass)
+{
+    if (sizeClass < NUMBER_OF_TINY_SIZE_CLASSES) {
+        return (size_t)(sizeClass + 1) * TINY_SIZE_CLASS_SPACING;
+    }
+
+    int i = sizeClass - NUMBER_OF_TINY_SIZE_CLASSES;
+    int k = FloorLog2(MAX_TINY_SIZE_CLASS_SIZE) + i / NUMBER_OF_SIZE_CLASSES_PER_DOUBLING;
+    int m = FloorLog2(NUMBER_OF_SIZE_CLASSES_PER_DOUBLING);
+    return ((size_t)1 << k) + ((size_t)(i % NUMBER_OF_SIZE_CLASSES_PER_DOUBLING + 1) << (k - m));
+}
+
+
+static int
+FloorLog2(size_t number)
+{
+    return (int)(sizeof number * CHAR_BIT) - 1 - __builtin_clzl(number);
+}
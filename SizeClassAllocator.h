@@ -0,0 +1,35 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+#pragma once
+
+
+#include <stddef.h>
+
+#include "MemoryPool.h"
+
+
+#define NUMBER_OF_SIZE_CLASSES 43
+
+
+/*
+ * Like `struct MemoryPool`, an allocator is owned by a single thread. Blocks may nevertheless be
+ * freed through any allocator (from any thread): blocks of foreign pools are handed back with
+ * `MemoryPool_FreeBlockRemotely`.
+ */
+struct SizeClassAllocator
+{
+    struct MemoryPool pools[NUMBER_OF_SIZE_CLASSES];
+};
+
+
+void SizeClassAllocator_Initialize(struct SizeClassAllocator *);
+void SizeClassAllocator_Finalize(const struct SizeClassAllocator *);
+void SizeClassAllocator_ShrinkToFit(struct SizeClassAllocator *);
+void *SizeClassAllocator_Allocate(struct SizeClassAllocator *, size_t);
+void *SizeClassAllocator_AllocateAligned(struct SizeClassAllocator *, size_t, size_t);
+void *SizeClassAllocator_Reallocate(struct SizeClassAllocator *, void *, size_t);
+void SizeClassAllocator_Free(struct SizeClassAllocator *, void *);
+size_t SizeClassAllocator_GetBlockSize(const void *);
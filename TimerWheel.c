@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+#include "TimerWheel.h"
+
+#include <stddef.h>
+#include <assert.h>
+
+
+#define OVERFLOW_LEVEL_NUMBER -1
+
+
+static bool TimerWheel_PlaceTimer(struct TimerWheel *, struct Timer *);
+static void TimerWheel_CascadeSlot(struct TimerWheel *, int, int);
+static void TimerWheel_PullOverflowTimers(struct TimerWheel *);
+
+
+void
+TimerWheel_Initialize(struct TimerWheel *self, uint64_t currentTime)
+{
+    assert(self != NULL);
+    self->currentTime = currentTime;
+    int i;
+
+    for (i = 0; i < TIMER_WHEEL_NUMBER_OF_LEVELS; ++i) {
+        self->slotMasks[i] = 0;
+        int j;
+
+        for (j = 0; j < TIMER_WHEEL_NUMBER_OF_SLOTS; ++j) {
+            List_Initialize(&self->slotListHeads[i][j]);
+        }
+    }
+
+    KeyedHeap_Initialize(&self->overflowHeap);
+    KeyedHeap_SetArity(&self->overflowHeap, 4);
+}
+
+
+void
+TimerWheel_Finalize(const struct TimerWheel *self)
+{
+    assert(self != NULL);
+    KeyedHeap_Finalize(&self->overflowHeap);
+}
+
+
+bool
+TimerWheel_ArmTimer(struct TimerWheel *self, struct Timer *timer, uint64_t dueTime)
+{
+    assert(self != NULL);
+    assert(timer != NULL);
+    timer->dueTime = dueTime > self->currentTime ? dueTime : self->currentTime + 1;
+    return TimerWheel_PlaceTimer(self, timer);
+}
+
+
+void
+TimerWheel_CancelTimer(struct TimerWheel *self, struct Timer *timer)
+{
+    assert(self != NULL);
+    assert(timer != NULL);
+
+    if (timer->levelNumber == OVERFLOW_LEVEL_NUMBER) {
+        KeyedHeap_RemoveNode(&self->overflowHeap, &timer->heapNode);
+        return;
+    }
+
+    int slotNumber = timer->dueTime >> (timer->levelNumber * TIMER_WHEEL_LEVEL_WIDTH)
+                     & (TIMER_WHEEL_NUMBER_OF_SLOTS - 1);
+    ListItem_Remove(&timer->listItem);
+
+    if (List_IsEmpty(&self->slotListHeads[timer->levelNumber][slotNumber])) {
+        self->slotMasks[timer->levelNumber] &= ~((uint64_t)1 << slotNumber);
+    }
+}
+
+
+void
+TimerWheel_Advance(struct TimerWheel *self, uint64_t time, struct ListItem *expiredTimerListHead)
+{
+    assert(self != NULL);
+    assert(time >= self->currentTime);
+    assert(expiredTimerListHead != NULL);
+
+    for (;;) {
+        uint64_t nextTime = TimerWheel_GetNextEventTime(self);
+
+        if (nextTime > time || nextTime == UINT64_MAX) {
+            self->currentTime = time;
+            return;
+        }
+
+        self->currentTime = nextTime;
+
+        if ((nextTime & (((uint64_t)1 << TIMER_WHEEL_HORIZON_WIDTH) - 1)) == 0) {
+            TimerWheel_PullOverflowTimers(self);
+        }
+
+        int i;
+
+        for (i = TIMER_WHEEL_NUMBER_OF_LEVELS - 1; i >= 1; --i) {
+            int shift = i * TIMER_WHEEL_LEVEL_WIDTH;
+
+            if ((nextTime & (((uint64_t)1 << shift) - 1)) == 0) {
+                TimerWheel_CascadeSlot(self, i, nextTime >> shift
+                                                & (TIMER_WHEEL_NUMBER_OF_SLOTS - 1));
+            }
+        }
+
+        int slotNumber = nextTime & (TIMER_WHEEL_NUMBER_OF_SLOTS - 1);
+        List_Splice(expiredTimerListHead, &self->slotListHeads[0][slotNumber]);
+        self->slotMasks[0] &= ~((uint64_t)1 << slotNumber);
+    }
+}
+
+
+uint64_t
+TimerWheel_GetNextEventTime(const struct TimerWheel *self)
+{
+    assert(self != NULL);
+    int i;
+
+    /*
+     * Slots of a level all come before the next slot of the level above, and they only hold
+     * timers due after the current time, in the span of the current slot of the level above.
+     */
+    for (i = 0; i < TIMER_WHEEL_NUMBER_OF_LEVELS; ++i) {
+        if (self->slotMasks[i] != 0) {
+            int shift = i * TIMER_WHEEL_LEVEL_WIDTH;
+            uint64_t spanTime = self->currentTime >> (shift + TIMER_WHEEL_LEVEL_WIDTH)
+                                << (shift + TIMER_WHEEL_LEVEL_WIDTH);
+            return spanTime + ((uint64_t)__builtin_ctzll(self->slotMasks[i]) << shift);
+        }
+    }
+
+    const struct HeapNode *node = KeyedHeap_GetTop(&self->overflowHeap);
+
+    if (node == NULL) {
+        return UINT64_MAX;
+    }
+
+    return KeyedHeap_GetNodeKey(&self->overflowHeap, node) >> TIMER_WHEEL_HORIZON_WIDTH
+           << TIMER_WHEEL_HORIZON_WIDTH;
+}
+
+
+static bool
+TimerWheel_PlaceTimer(struct TimerWheel *self, struct Timer *timer)
+{
+    /*
+     * A timer goes in the lowest level whose span, that of the current slot of the level above,
+     * contains its due time.
+     */
+    uint64_t differentBits = timer->dueTime ^ self->currentTime;
+
+    if (differentBits >> TIMER_WHEEL_HORIZON_WIDTH != 0) {
+        if (!KeyedHeap_InsertNode(&self->overflowHeap, &timer->heapNode, timer->dueTime)) {
+            return false;
+        }
+
+        timer->levelNumber = OVERFLOW_LEVEL_NUMBER;
+        return true;
+    }
+
+    int levelNumber = differentBits < TIMER_WHEEL_NUMBER_OF_SLOTS
+                      ? 0 : (63 - __builtin_clzll(differentBits)) / TIMER_WHEEL_LEVEL_WIDTH;
+    int slotNumber = timer->dueTime >> (levelNumber * TIMER_WHEEL_LEVEL_WIDTH)
+                     & (TIMER_WHEEL_NUMBER_OF_SLOTS - 1);
+    List_InsertBack(&self->slotListHeads[levelNumber][slotNumber], &timer->listItem);
+    self->slotMasks[levelNumber] |= (uint64_t)1 << slotNumber;
+    timer->levelNumber = levelNumber;
+    return true;
+}
+
+
+static void
+TimerWheel_CascadeSlot(struct TimerWheel *self, int levelNumber, int slotNumber)
+{
+    if ((self->slotMasks[levelNumber] & (uint64_t)1 << slotNumber) == 0) {
+        return;
+    }
+
+    struct ListItem timerListHead;
+    List_Initialize(&timerListHead);
+    List_Splice(&timerListHead, &self->slotListHeads[levelNumber][slotNumber]);
+    self->slotMasks[levelNumber] &= ~((uint64_t)1 << slotNumber);
+    struct ListItem *timerListItem;
+    struct ListItem *temp;
+
+    FOR_EACH_LIST_ITEM_SAFE(timerListItem, temp, &timerListHead) {
+        TimerWheel_PlaceTimer(self, CONTAINER_OF(timerListItem, struct Timer, listItem));
+    }
+}
+
+
+static void
+TimerWheel_PullOverflowTimers(struct TimerWheel *self)
+{
+    struct HeapNode *node;
+
+    while ((node = KeyedHeap_GetTop(&self->overflowHeap)) != NULL
+           && (KeyedHeap_GetNodeKey(&self->overflowHeap, node) ^ self->currentTime)
+              >> TIMER_WHEEL_HORIZON_WIDTH == 0) {
+        KeyedHeap_RemoveNode(&self->overflowHeap, node);
+        TimerWheel_PlaceTimer(self, CONTAINER_OF(node, struct Timer, heapNode));
+    }
+}
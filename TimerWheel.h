@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+#pragma once
+
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "List.h"
+#include "Heap.h"
+#include "KeyedHeap.h"
+
+
+#define TIMER_WHEEL_LEVEL_WIDTH 6
+#define TIMER_WHEEL_NUMBER_OF_SLOTS (1 << TIMER_WHEEL_LEVEL_WIDTH)
+#define TIMER_WHEEL_NUMBER_OF_LEVELS 4
+#define TIMER_WHEEL_HORIZON_WIDTH (TIMER_WHEEL_LEVEL_WIDTH * TIMER_WHEEL_NUMBER_OF_LEVELS)
+
+
+/*
+ * A hierarchical timing wheel: level `i` has a slot for each of the next 64 spans of 64^i ticks.
+ * Timers are armed and cancelled in constant time, by being linked into and out of the slot of
+ * their due time. Timers due past the horizon (2^24 ticks) wait in a heap, and are moved into the
+ * wheel, as are those in higher levels into lower ones, as their spans are reached. A wheel must
+ * not be moved once initialized.
+ */
+struct TimerWheel
+{
+    uint64_t currentTime;
+    uint64_t slotMasks[TIMER_WHEEL_NUMBER_OF_LEVELS];
+    struct ListItem slotListHeads[TIMER_WHEEL_NUMBER_OF_LEVELS][TIMER_WHEEL_NUMBER_OF_SLOTS];
+    struct KeyedHeap overflowHeap;
+};
+
+
+struct Timer
+{
+    uint64_t dueTime;
+    int levelNumber;
+
+    union {
+        struct ListItem listItem;
+        struct HeapNode heapNode;
+    };
+};
+
+
+/*
+ * The wheel starts at the given time, in ticks.
+ */
+void TimerWheel_Initialize(struct TimerWheel *, uint64_t);
+void TimerWheel_Finalize(const struct TimerWheel *);
+
+/*
+ * A timer due no later than the current time is due at the next tick, which its due time is set
+ * to. Fails only when a timer past the horizon cannot be put in the heap.
+ */
+bool TimerWheel_ArmTimer(struct TimerWheel *, struct Timer *, uint64_t);
+void TimerWheel_CancelTimer(struct TimerWheel *, struct Timer *);
+
+/*
+ * Advances to the given time and moves the timers due by then, whole slots at a time, to the back
+ * of the given list, where they are linked through `listItem`. Runs of ticks without timers due
+ * are skipped.
+ */
+void TimerWheel_Advance(struct TimerWheel *, uint64_t, struct ListItem *);
+
+/*
+ * Returns the first time at which advancing does some work, which is no later than the earliest
+ * due time, or `UINT64_MAX` without timers.
+ */
+uint64_t TimerWheel_GetNextEventTime(const struct TimerWheel *);
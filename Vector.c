@@ -3,12 +3,56 @@
  */
 
 
+#define _GNU_SOURCE
+
 #include "Vector.h"
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <limits.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "AllocationProfiler.h"
+
+
+#define MAX_NUMBER_OF_SORT_THREADS 64
+#define MIN_SORT_RUN_LENGTH 4096
+#define RADIX_WIDTH 8
+#define RADIX (1 << RADIX_WIDTH)
+
 
+struct VectorSortTask
+{
+    size_t elementSize;
+    int (*elementComparer)(const void *, const void *);
+    char *elements;
+    char *buffer;
+    ptrdiff_t firstIndex;
+    ptrdiff_t middleIndex;
+    ptrdiff_t lastIndex;
+};
+
+
+struct VectorSortKey
+{
+    uint64_t value;
+    ptrdiff_t index;
+};
+
+
+static bool Vector_SetCapacity(struct Vector *, ptrdiff_t);
+static void Vector_FreeElements(const struct Vector *);
+static void *Vector_MapElements(const struct Vector *, size_t);
+static void *Vector_RemapElements(const struct Vector *, size_t);
+static void Vector_ZeroElements(const struct Vector *, ptrdiff_t, ptrdiff_t);
+
+static void RunSortTasks(struct VectorSortTask *, int, void *(*)(void *));
+static void *SortRun(void *);
+static void *MergeRuns(void *);
+static size_t RoundUpToPageSize(size_t);
 
 static size_t NextPowerOfTwo(size_t);
 
@@ -17,10 +61,34 @@ void
 Vector_Initialize(struct Vector *self, size_t elementSize)
 {
     assert(self != NULL);
+    assert(elementSize >= 1);
     self->elementSize = elementSize;
+    self->allocator = &SystemAllocator;
     self->elements = NULL;
-    self->size = 0;
+    self->bufferOffset = 0;
+    self->isBuffered = false;
+    self->capacity = 0;
+    self->bufferCapacity = 0;
     self->length = 0;
+    self->growthFactor = VECTOR_DEFAULT_GROWTH_FACTOR;
+    self->mappingThreshold = VECTOR_DEFAULT_MAPPING_THRESHOLD;
+    self->usesHugePages = false;
+    self->isMapped = false;
+    self->numberOfDirtyElements = 0;
+}
+
+
+void
+Vector_InitializeWithBuffer(struct Vector *self, size_t elementSize, void *buffer
+                            , ptrdiff_t bufferCapacity)
+{
+    assert(self != NULL);
+    assert(buffer != NULL && bufferCapacity >= 1);
+    Vector_Initialize(self, elementSize);
+    self->bufferOffset = (char *)buffer - (char *)self;
+    self->isBuffered = true;
+    self->capacity = bufferCapacity;
+    self->bufferCapacity = bufferCapacity;
 }
 
 
@@ -28,7 +96,36 @@ void
 Vector_Finalize(const struct Vector *self)
 {
     assert(self != NULL);
-    free(self->elements);
+    Vector_FreeElements(self);
+}
+
+
+void
+Vector_SetAllocator(struct Vector *self, struct Allocator *allocator)
+{
+    assert(self != NULL);
+    assert(self->isBuffered || self->elements == NULL);
+    assert(allocator != NULL);
+    self->allocator = allocator;
+}
+
+
+void
+Vector_SetGrowthFactor(struct Vector *self, double growthFactor)
+{
+    assert(self != NULL);
+    assert(growthFactor > 1.0);
+    self->growthFactor = growthFactor;
+}
+
+
+void
+Vector_SetMappingThreshold(struct Vector *self, size_t mappingThreshold, bool usesHugePages)
+{
+    assert(self != NULL);
+    assert(self->isBuffered || self->elements == NULL);
+    self->mappingThreshold = mappingThreshold;
+    self->usesHugePages = usesHugePages;
 }
 
 
@@ -37,59 +134,571 @@ Vector_SetLength(struct Vector *self, ptrdiff_t length, bool zeroNewElements)
 {
     assert(self != NULL);
     assert(length >= 0);
+
+    if ((size_t)length > PTRDIFF_MAX / self->elementSize) {
+        return false;
+    }
+
     size_t size = NextPowerOfTwo(length * self->elementSize);
 
-    if (self->size == size) {
+    if (length > self->capacity || size < self->capacity * self->elementSize) {
+        if (!Vector_SetCapacity(self, size / self->elementSize)) {
+            return false;
+        }
+    }
+
+    if (zeroNewElements && length > self->length) {
+        Vector_ZeroElements(self, self->length, length);
+    }
+
+    self->length = length;
+    __Vector_UpdateDirtyElements(self);
+    return true;
+}
+
+
+bool
+Vector_Expand(struct Vector *self, bool zeroNewElements)
+{
+    assert(self != NULL && self->capacity != 0);
+
+    if (self->capacity > PTRDIFF_MAX / 2 || !Vector_SetCapacity(self, 2 * self->capacity)) {
+        return false;
+    }
+
+    if (zeroNewElements) {
+        Vector_ZeroElements(self, self->length, self->capacity);
+    }
+
+    self->length = self->capacity;
+    __Vector_UpdateDirtyElements(self);
+    return true;
+}
+
+
+bool
+Vector_Reserve(struct Vector *self, ptrdiff_t capacity)
+{
+    assert(self != NULL);
+    assert(capacity >= 0);
+
+    if (capacity <= self->capacity) {
         return true;
     }
 
-    if (size == 0) {
-        free(self->elements);
-        self->elements = NULL;
-        self->size = 0;
-        self->length = 0;
+    return Vector_SetCapacity(self, capacity);
+}
+
+
+bool
+Vector_PushBack(struct Vector *self, const void *element)
+{
+    assert(self != NULL);
+    assert(element != NULL);
+    return __Vector_PushBack(self, element, self->elementSize);
+}
+
+
+void
+Vector_PopBack(struct Vector *self, void *element)
+{
+    assert(self != NULL);
+    assert(self->length >= 1);
+    __Vector_PopBack(self, element, self->elementSize);
+}
+
+
+bool
+Vector_Insert(struct Vector *self, ptrdiff_t index, const void *elements
+              , ptrdiff_t numberOfElements)
+{
+    assert(self != NULL);
+    assert(index >= 0 && index <= self->length);
+    assert(numberOfElements >= 0);
+    assert(elements != NULL || numberOfElements == 0);
+
+    if (numberOfElements == 0) {
         return true;
     }
 
-    void *elements = realloc(self->elements, size);
+    if (numberOfElements > PTRDIFF_MAX - self->length) {
+        return false;
+    }
 
-    if (elements == NULL) {
+    if (self->length + numberOfElements > self->capacity
+        && !__Vector_Grow(self, self->length + numberOfElements)) {
+        return false;
+    }
+
+    char *gap = (char *)Vector_GetElements(self) + index * self->elementSize;
+    size_t gapSize = numberOfElements * self->elementSize;
+    memmove(gap + gapSize, gap, (self->length - index) * self->elementSize);
+    memcpy(gap, elements, gapSize);
+    self->length += numberOfElements;
+    __Vector_UpdateDirtyElements(self);
+    return true;
+}
+
+
+bool
+Vector_Append(struct Vector *self, const void *elements, ptrdiff_t numberOfElements)
+{
+    assert(self != NULL);
+    return Vector_Insert(self, self->length, elements, numberOfElements);
+}
+
+
+void
+Vector_Erase(struct Vector *self, ptrdiff_t index, ptrdiff_t numberOfElements)
+{
+    assert(self != NULL);
+    assert(index >= 0 && numberOfElements >= 0 && numberOfElements <= self->length - index);
+
+    if (numberOfElements == 0) {
+        return;
+    }
+
+    char *gap = (char *)Vector_GetElements(self) + index * self->elementSize;
+    size_t gapSize = numberOfElements * self->elementSize;
+    memmove(gap, gap + gapSize, (self->length - index - numberOfElements) * self->elementSize);
+    self->length -= numberOfElements;
+}
+
+
+bool
+Vector_Sort(struct Vector *self, int (*elementComparer)(const void *, const void *)
+            , int numberOfThreads)
+{
+    assert(self != NULL);
+    assert(elementComparer != NULL);
+    assert(numberOfThreads >= 1);
+
+    if (numberOfThreads > self->length / MIN_SORT_RUN_LENGTH) {
+        numberOfThreads = self->length / MIN_SORT_RUN_LENGTH;
+    }
+
+    if (numberOfThreads > MAX_NUMBER_OF_SORT_THREADS) {
+        numberOfThreads = MAX_NUMBER_OF_SORT_THREADS;
+    }
+
+    if (numberOfThreads <= 1) {
+        if (self->length >= 2) {
+            qsort(Vector_GetElements(self), self->length, self->elementSize, elementComparer);
+        }
+
+        return true;
+    }
+
+    size_t bufferSize = self->length * self->elementSize;
+    char *buffer = self->allocator->allocate(self->allocator, bufferSize);
+
+    if (buffer == NULL) {
         return false;
     }
 
-    if (zeroNewElements && size > self->size) {
-        memset((char *)elements + self->size, 0, size - self->size);
+    /*
+     * Each thread sorts a run of its own, then the runs are merged pairwise, back and forth
+     * between the elements and the buffer, with a thread for each pair.
+     */
+    ptrdiff_t runBounds[MAX_NUMBER_OF_SORT_THREADS + 1];
+    struct VectorSortTask tasks[MAX_NUMBER_OF_SORT_THREADS];
+    char *elements = Vector_GetElements(self);
+    int i;
+
+    for (i = 0; i <= numberOfThreads; ++i) {
+        runBounds[i] = self->length / numberOfThreads * i
+                       + self->length % numberOfThreads * i / numberOfThreads;
     }
 
-    self->elements = elements;
-    self->size = size;
-    self->length = size / self->elementSize;
+    for (i = 0; i < numberOfThreads; ++i) {
+        tasks[i] = (struct VectorSortTask) {
+            .elementSize = self->elementSize,
+            .elementComparer = elementComparer,
+            .elements = elements,
+            .firstIndex = runBounds[i],
+            .lastIndex = runBounds[i + 1]
+        };
+    }
+
+    RunSortTasks(tasks, numberOfThreads, SortRun);
+    char *source = elements;
+    char *target = buffer;
+    int runWidth;
+
+    for (runWidth = 1; runWidth < numberOfThreads; runWidth *= 2) {
+        int numberOfTasks = 0;
+
+        for (i = 0; i < numberOfThreads; i += 2 * runWidth) {
+            tasks[numberOfTasks++] = (struct VectorSortTask) {
+                .elementSize = self->elementSize,
+                .elementComparer = elementComparer,
+                .elements = source,
+                .buffer = target,
+                .firstIndex = runBounds[i],
+                .middleIndex = runBounds[i + runWidth < numberOfThreads ? i + runWidth
+                                                                         : numberOfThreads],
+                .lastIndex = runBounds[i + 2 * runWidth < numberOfThreads ? i + 2 * runWidth
+                                                                           : numberOfThreads]
+            };
+        }
+
+        RunSortTasks(tasks, numberOfTasks, MergeRuns);
+        char *temp = source;
+        source = target;
+        target = temp;
+    }
+
+    if (source != elements) {
+        memcpy(elements, source, bufferSize);
+    }
+
+    self->allocator->free(self->allocator, buffer, bufferSize);
     return true;
 }
 
 
 bool
-Vector_Expand(struct Vector *self, bool zeroNewElements)
+Vector_SortByKey(struct Vector *self, uint64_t (*keyExtractor)(const void *), int keySize)
 {
-    assert(self != NULL && self->size != 0);
-    size_t size = 2 * self->size;
-    void *elements = realloc(self->elements, size);
+    assert(self != NULL);
+    assert(keyExtractor != NULL);
+    assert(keySize >= 1 && keySize <= (int)sizeof(uint64_t));
+
+    if (self->length <= 1) {
+        return true;
+    }
+
+    size_t bufferSize = self->length * self->elementSize;
+
+    if ((size_t)self->length > (PTRDIFF_MAX - bufferSize) / (2 * sizeof(struct VectorSortKey))) {
+        return false;
+    }
+
+    size_t blockSize = 2 * self->length * sizeof(struct VectorSortKey) + bufferSize;
+    struct VectorSortKey *block = self->allocator->allocate(self->allocator, blockSize);
+
+    if (block == NULL) {
+        return false;
+    }
+
+    /*
+     * Keys are extracted once, along with the indexes of their elements, and the histograms of
+     * all digits are counted in the same pass, which also tells the digits shared by all keys,
+     * whose passes are skipped. Elements are moved only once, after the keys are sorted.
+     */
+    struct VectorSortKey *keys = block;
+    struct VectorSortKey *keys2 = keys + self->length;
+    char *buffer = (char *)(keys2 + self->length);
+    ptrdiff_t counts[sizeof(uint64_t)][RADIX] = {{0}};
+    char *elements = Vector_GetElements(self);
+    const char *element = elements;
+    ptrdiff_t i;
+
+    for (i = 0; i < self->length; ++i) {
+        uint64_t keyValue = keyExtractor(element);
+        keys[i].value = keyValue;
+        keys[i].index = i;
+        int j;
+
+        for (j = 0; j < keySize; ++j) {
+            ++counts[j][keyValue >> (j * RADIX_WIDTH) & (RADIX - 1)];
+        }
+
+        element += self->elementSize;
+    }
+
+    int j;
+
+    for (j = 0; j < keySize; ++j) {
+        int shift = j * RADIX_WIDTH;
+
+        if (counts[j][keys[0].value >> shift & (RADIX - 1)] == self->length) {
+            continue;
+        }
+
+        ptrdiff_t offsets[RADIX];
+        ptrdiff_t offset = 0;
+        int k;
+
+        for (k = 0; k < RADIX; ++k) {
+            offsets[k] = offset;
+            offset += counts[j][k];
+        }
+
+        for (i = 0; i < self->length; ++i) {
+            keys2[offsets[keys[i].value >> shift & (RADIX - 1)]++] = keys[i];
+        }
+
+        struct VectorSortKey *temp = keys;
+        keys = keys2;
+        keys2 = temp;
+    }
+
+    for (i = 0; i < self->length; ++i) {
+        memcpy(buffer + i * self->elementSize
+               , elements + keys[i].index * self->elementSize, self->elementSize);
+    }
+
+    memcpy(elements, buffer, bufferSize);
+    self->allocator->free(self->allocator, block, blockSize);
+    return true;
+}
+
+
+bool
+__Vector_Grow(struct Vector *self, ptrdiff_t minCapacity)
+{
+    double capacity = self->capacity * self->growthFactor;
+
+    if (capacity < minCapacity) {
+        capacity = minCapacity;
+    }
+
+    if (capacity > (double)(PTRDIFF_MAX / self->elementSize)) {
+        capacity = PTRDIFF_MAX / self->elementSize;
+
+        if (capacity < minCapacity) {
+            return false;
+        }
+    }
+
+    return Vector_SetCapacity(self, capacity);
+}
+
+
+static bool
+Vector_SetCapacity(struct Vector *self, ptrdiff_t capacity)
+{
+    if ((size_t)capacity > PTRDIFF_MAX / self->elementSize) {
+        return false;
+    }
+
+    if (capacity <= self->bufferCapacity) {
+        if (!self->isBuffered) {
+            if (self->length > self->bufferCapacity) {
+                self->length = self->bufferCapacity;
+            }
+
+            if (self->length >= 1) {
+                memcpy((char *)self + self->bufferOffset, self->elements
+                       , self->length * self->elementSize);
+            }
+
+            /*
+             * Vectors without a buffer are only shrunk here to nothing.
+             */
+            Vector_FreeElements(self);
+            self->elements = NULL;
+            self->isBuffered = self->bufferCapacity >= 1;
+            self->capacity = self->bufferCapacity;
+            self->isMapped = false;
+        }
+
+        if (self->length > capacity) {
+            self->length = capacity;
+        }
+
+        return true;
+    }
+
+    bool isBuffered = self->isBuffered;
+    size_t size = capacity * self->elementSize;
+    bool isMapped = size >= self->mappingThreshold;
+    void *elements;
+
+    if (isMapped) {
+        elements = self->isMapped ? Vector_RemapElements(self, size)
+                                  : Vector_MapElements(self, size);
+    } else if (self->isMapped || isBuffered) {
+        elements = self->allocator->allocate(self->allocator, size);
+
+        if (elements != NULL && self->length >= 1) {
+            memcpy(elements, Vector_GetElements(self)
+                   , (self->length < capacity ? self->length : capacity) * self->elementSize);
+        }
+    } else {
+        elements = self->allocator->reallocate(self->allocator, self->elements
+                                               , self->capacity * self->elementSize, size);
+    }
 
     if (elements == NULL) {
         return false;
     }
 
-    if (zeroNewElements) {
-        memset((char *)elements + self->size, 0, size - self->size);
+    /*
+     * Remapped and reallocated elements are freed along the way, yet only once that succeeds.
+     */
+    if (self->isMapped != isMapped && !isBuffered) {
+        Vector_FreeElements(self);
+    } else if (!isBuffered) {
+        ALLOCATION_PROFILER_RECORD_FREE(self->elements);
     }
 
+    ALLOCATION_PROFILER_RECORD_ALLOCATION(elements, size);
     self->elements = elements;
-    self->size = size;
-    self->length = size / self->elementSize;
+    self->isBuffered = false;
+    self->capacity = capacity;
+    self->isMapped = isMapped;
+
+    if (self->length > capacity) {
+        self->length = capacity;
+    }
+
+    if (self->numberOfDirtyElements > capacity) {
+        self->numberOfDirtyElements = capacity;
+    }
+
     return true;
 }
 
 
+static void
+Vector_FreeElements(const struct Vector *self)
+{
+    if (self->isBuffered || self->elements == NULL) {
+        return;
+    }
+
+    ALLOCATION_PROFILER_RECORD_FREE(self->elements);
+
+    if (self->isMapped) {
+        munmap(self->elements, RoundUpToPageSize(self->capacity * self->elementSize));
+    } else {
+        self->allocator->free(self->allocator, self->elements
+                              , self->capacity * self->elementSize);
+    }
+}
+
+
+static void *
+Vector_MapElements(const struct Vector *self, size_t size)
+{
+    /*
+     * Only the elements in use are carried over, the rest of the fresh mapping being zero.
+     */
+    void *elements = mmap(NULL, RoundUpToPageSize(size), PROT_READ | PROT_WRITE
+                          , MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (elements == MAP_FAILED) {
+        return NULL;
+    }
+
+#ifdef MADV_HUGEPAGE
+    if (self->usesHugePages) {
+        madvise(elements, RoundUpToPageSize(size), MADV_HUGEPAGE);
+    }
+#endif
+    if (self->length >= 1) {
+        memcpy(elements, Vector_GetElements(self), self->length * self->elementSize);
+    }
+
+    return elements;
+}
+
+
+static void *
+Vector_RemapElements(const struct Vector *self, size_t size)
+{
+    size_t oldSize = self->capacity * self->elementSize;
+    void *elements = mremap(self->elements, RoundUpToPageSize(oldSize), RoundUpToPageSize(size)
+                            , MREMAP_MAYMOVE);
+
+    if (elements == MAP_FAILED) {
+        return NULL;
+    }
+
+    if (size < oldSize) {
+        /*
+         * Keeps the mapping past the capacity zero, as pages added later will be.
+         */
+        memset((char *)elements + size, 0, RoundUpToPageSize(size) - size);
+    }
+
+    return elements;
+}
+
+
+static void
+Vector_ZeroElements(const struct Vector *self, ptrdiff_t firstIndex, ptrdiff_t lastIndex)
+{
+    if (self->isMapped && lastIndex > self->numberOfDirtyElements) {
+        lastIndex = firstIndex > self->numberOfDirtyElements ? firstIndex
+                                                              : self->numberOfDirtyElements;
+    }
+
+    memset((char *)Vector_GetElements(self) + firstIndex * self->elementSize, 0
+           , (lastIndex - firstIndex) * self->elementSize);
+}
+
+
+static void
+RunSortTasks(struct VectorSortTask *tasks, int numberOfTasks, void *(*taskRunner)(void *))
+{
+    pthread_t threads[MAX_NUMBER_OF_SORT_THREADS];
+    bool threadIsCreated[MAX_NUMBER_OF_SORT_THREADS];
+    int i;
+
+    for (i = 1; i < numberOfTasks; ++i) {
+        threadIsCreated[i] = pthread_create(&threads[i], NULL, taskRunner, &tasks[i]) == 0;
+
+        /*
+         * Runs the task on the calling thread when no thread is left for it.
+         */
+        if (!threadIsCreated[i]) {
+            taskRunner(&tasks[i]);
+        }
+    }
+
+    taskRunner(&tasks[0]);
+
+    for (i = 1; i < numberOfTasks; ++i) {
+        if (threadIsCreated[i]) {
+            pthread_join(threads[i], NULL);
+        }
+    }
+}
+
+
+static void *
+SortRun(void *argument)
+{
+    const struct VectorSortTask *task = argument;
+    qsort(task->elements + task->firstIndex * task->elementSize, task->lastIndex - task->firstIndex
+          , task->elementSize, task->elementComparer);
+    return NULL;
+}
+
+
+static void *
+MergeRuns(void *argument)
+{
+    const struct VectorSortTask *task = argument;
+    size_t elementSize = task->elementSize;
+    const char *element1 = task->elements + task->firstIndex * elementSize;
+    const char *elements1End = task->elements + task->middleIndex * elementSize;
+    const char *element2 = elements1End;
+    const char *elements2End = task->elements + task->lastIndex * elementSize;
+    char *element = task->buffer + task->firstIndex * elementSize;
+
+    while (element1 < elements1End && element2 < elements2End) {
+        if (task->elementComparer(element2, element1) < 0) {
+            memcpy(element, element2, elementSize);
+            element2 += elementSize;
+        } else {
+            memcpy(element, element1, elementSize);
+            element1 += elementSize;
+        }
+
+        element += elementSize;
+    }
+
+    memcpy(element, element1, elements1End - element1);
+    element += elements1End - element1;
+    memcpy(element, element2, elements2End - element2);
+    return NULL;
+}
+
+
 static size_t
 NextPowerOfTwo(size_t number)
 {
@@ -103,3 +712,11 @@ NextPowerOfTwo(size_t number)
     ++number;
     return number;
 }
+
+
+static size_t
+RoundUpToPageSize(size_t size)
+{
+    size_t pageSize = sysconf(_SC_PAGESIZE);
+    return (size + pageSize - 1) & ~(pageSize - 1);
+}
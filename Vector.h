@@ -7,33 +7,165 @@
 
 
 #include <stddef.h>
+#include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 #include <assert.h>
 
+#include "Allocator.h"
+
+
+#define VECTOR_DEFAULT_GROWTH_FACTOR 1.5
+#define VECTOR_DEFAULT_MAPPING_THRESHOLD ((size_t)67108864)
+
+/*
+ * Declares a vector whose first elements live inline, in the enclosing structure, until they
+ * overflow to the heap. The inline elements are located relative to the vector, which can thus
+ * be moved along with them.
+ */
+#define SMALL_VECTOR(elementType, numberOfInlineElements)   \
+    struct {                                                \
+        struct Vector vector;                               \
+        elementType inlineElements[numberOfInlineElements]; \
+    }
+
+#define SMALL_VECTOR_INITIALIZE(smallVector)                                                  \
+    Vector_InitializeWithBuffer(&(smallVector)->vector, sizeof *(smallVector)->inlineElements \
+                                , (smallVector)->inlineElements                               \
+                                , sizeof (smallVector)->inlineElements                        \
+                                  / sizeof *(smallVector)->inlineElements)
+
+/*
+ * Defines counterparts of the `Vector` functions for vectors of `type`, with the element size
+ * known at compile time.
+ */
+#define DEFINE_VECTOR(name, type)                                \
+    static inline void                                           \
+    name##_Initialize(struct Vector *vector)                     \
+    {                                                            \
+        Vector_Initialize(vector, sizeof(type));                 \
+    }                                                            \
+                                                                 \
+    static inline type *                                         \
+    name##_GetElements(const struct Vector *vector)              \
+    {                                                            \
+        assert(vector != NULL);                                  \
+        assert(vector->elementSize == sizeof(type));             \
+        return Vector_GetElements(vector);                       \
+    }                                                            \
+                                                                 \
+    static inline type *                                         \
+    name##_At(const struct Vector *vector, ptrdiff_t index)      \
+    {                                                            \
+        assert(index >= 0 && index < Vector_GetLength(vector));  \
+        return &name##_GetElements(vector)[index];               \
+    }                                                            \
+                                                                 \
+    static inline bool                                           \
+    name##_PushBack(struct Vector *vector, const type *element)  \
+    {                                                            \
+        assert(vector != NULL);                                  \
+        assert(vector->elementSize == sizeof(type));             \
+        assert(element != NULL);                                 \
+        return __Vector_PushBack(vector, element, sizeof(type)); \
+    }                                                            \
+                                                                 \
+    static inline void                                           \
+    name##_PopBack(struct Vector *vector, type *element)         \
+    {                                                            \
+        assert(vector != NULL);                                  \
+        assert(vector->elementSize == sizeof(type));             \
+        assert(vector->length >= 1);                             \
+        __Vector_PopBack(vector, element, sizeof(type));         \
+    }
+
 
 struct Vector
 {
     size_t elementSize;
+    struct Allocator *allocator;
     void *elements;
-    size_t size;
+    ptrdiff_t bufferOffset;
+    bool isBuffered;
+    ptrdiff_t capacity;
+    ptrdiff_t bufferCapacity;
     ptrdiff_t length;
+    double growthFactor;
+    size_t mappingThreshold;
+    bool usesHugePages;
+    bool isMapped;
+    ptrdiff_t numberOfDirtyElements;
 };
 
 
 static inline void *Vector_GetElements(const struct Vector *);
 static inline ptrdiff_t Vector_GetLength(const struct Vector *);
+static inline ptrdiff_t Vector_GetCapacity(const struct Vector *);
 
 void Vector_Initialize(struct Vector *, size_t);
+
+/*
+ * The buffer must lie in the same object as the vector, so that they are moved together.
+ */
+void Vector_InitializeWithBuffer(struct Vector *, size_t, void *, ptrdiff_t);
+
 void Vector_Finalize(const struct Vector *);
+
+/*
+ * The capacity grows by the growth factor (no less than 1) whenever elements are added to a
+ * full vector, so a factor below 2 lets the allocator reuse the blocks given back earlier.
+ */
+void Vector_SetAllocator(struct Vector *, struct Allocator *);
+void Vector_SetGrowthFactor(struct Vector *, double);
+
+/*
+ * Storage of at least the given size lives in an anonymous mapping of its own, optionally backed
+ * by transparent huge pages, which is resized with mremap(2) instead of being copied. Elements
+ * past those ever in use are known to be zero there, so zeroing them is skipped.
+ */
+void Vector_SetMappingThreshold(struct Vector *, size_t, bool);
+
+/*
+ * Sets the length exactly, while keeping the capacity to the next power of two in bytes: the
+ * capacity grows to it when exceeded and shrinks to it when it is smaller.
+ */
 bool Vector_SetLength(struct Vector *, ptrdiff_t, bool);
+
+/*
+ * Doubles the capacity, which a non-empty vector must have, and sets the length to it.
+ */
 bool Vector_Expand(struct Vector *, bool);
 
+bool Vector_Reserve(struct Vector *, ptrdiff_t);
+bool Vector_PushBack(struct Vector *, const void *);
+void Vector_PopBack(struct Vector *, void *);
+bool Vector_Insert(struct Vector *, ptrdiff_t, const void *, ptrdiff_t);
+bool Vector_Append(struct Vector *, const void *, ptrdiff_t);
+void Vector_Erase(struct Vector *, ptrdiff_t, ptrdiff_t);
+
+/*
+ * Sorts runs of the elements with qsort(3) on up to the given number of threads, then merges them
+ * pairwise in parallel. Like qsort(3), the sort is not stable.
+ */
+bool Vector_Sort(struct Vector *, int (*)(const void *, const void *), int);
+
+/*
+ * Stable LSD radix sort by the unsigned keys the extractor returns, of which only the given
+ * number of low-order bytes are looked at. Keys are extracted once per element.
+ */
+bool Vector_SortByKey(struct Vector *, uint64_t (*)(const void *), int);
+
+bool __Vector_Grow(struct Vector *, ptrdiff_t);
+static inline bool __Vector_PushBack(struct Vector *, const void *, size_t);
+static inline void __Vector_PopBack(struct Vector *, void *, size_t);
+static inline void __Vector_UpdateDirtyElements(struct Vector *);
+
 
 static inline void *
 Vector_GetElements(const struct Vector *self)
 {
     assert(self != NULL);
-    return self->elements;
+    return self->isBuffered ? (char *)self + self->bufferOffset : self->elements;
 }
 
 
@@ -43,3 +175,46 @@ Vector_GetLength(const struct Vector *self)
     assert(self != NULL);
     return self->length;
 }
+
+
+static inline ptrdiff_t
+Vector_GetCapacity(const struct Vector *self)
+{
+    assert(self != NULL);
+    return self->capacity;
+}
+
+
+static inline __attribute__((always_inline)) bool
+__Vector_PushBack(struct Vector *self, const void *element, size_t elementSize)
+{
+    if (self->length == self->capacity && !__Vector_Grow(self, self->length + 1)) {
+        return false;
+    }
+
+    memcpy((char *)Vector_GetElements(self) + self->length * elementSize, element, elementSize);
+    ++self->length;
+    __Vector_UpdateDirtyElements(self);
+    return true;
+}
+
+
+static inline __attribute__((always_inline)) void
+__Vector_PopBack(struct Vector *self, void *element, size_t elementSize)
+{
+    --self->length;
+
+    if (element != NULL) {
+        memcpy(element, (char *)Vector_GetElements(self) + self->length * elementSize
+               , elementSize);
+    }
+}
+
+
+static inline void
+__Vector_UpdateDirtyElements(struct Vector *self)
+{
+    if (self->length > self->numberOfDirtyElements) {
+        self->numberOfDirtyElements = self->length;
+    }
+}
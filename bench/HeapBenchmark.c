@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+/*
+ * Measures `struct Heap` of arity 2, 4 and 8, with segments from `SystemAllocator` and from
+ * `AlignedSystemAllocator`, on insert, adjust and remove mixes, as the heap grows:
+ *
+ *     cc -std=gnu11 -O2 -DNDEBUG -I.. -o HeapBenchmark HeapBenchmark.c ../Heap.c ../Vector.c \
+ *        ../Allocator.c -lpthread
+ *     ./HeapBenchmark [<max number of nodes>]
+ *
+ * The mixes are:
+ *
+ *     insert: inserting all nodes, one by one, into an empty heap;
+ *     hold:   popping the top and inserting it back with a later key;
+ *     adjust: giving a random node a random key and adjusting it;
+ *     remove: removing a random node and inserting it back with a random key.
+ *
+ * Times are the best of a few runs, in nanoseconds per operation.
+ */
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "Heap.h"
+
+
+#define NUMBER_OF_RUNS 3
+#define NUMBER_OF_OPERATIONS (1 << 21)
+#define NUMBER_OF_MIXES 4
+
+
+struct Item
+{
+    uint64_t key;
+    struct HeapNode heapNode;
+};
+
+
+static bool MeasureMixes(struct Item *, int, int, struct Allocator *, double *);
+static bool FillHeap(struct Heap *, struct Item *, int, uint64_t *);
+
+static int CompareItems(const struct HeapNode *, const struct HeapNode *);
+static uint64_t DrawRandomNumber(uint64_t *);
+static double GetTime(void);
+
+
+int
+main(int argc, char **argv)
+{
+    int maxNumberOfNodes = argc >= 2 ? atoi(argv[1]) : 1 << 22;
+
+    if (maxNumberOfNodes < 1) {
+        fprintf(stderr, "usage: %s [<max number of nodes>]\n", argv[0]);
+        return 1;
+    }
+
+    struct Item *items = malloc(maxNumberOfNodes * sizeof *items);
+
+    if (items == NULL) {
+        return 1;
+    }
+
+    printf("%10s %6s %9s %10s %10s %10s %10s\n", "nodes", "arity", "segments", "insert", "hold"
+           , "adjust", "remove");
+    int numberOfNodes;
+
+    for (numberOfNodes = 1 << 10; numberOfNodes <= maxNumberOfNodes; numberOfNodes *= 8) {
+        int arity;
+
+        for (arity = 2; arity <= HEAP_MAX_ARITY; arity *= 2) {
+            int i;
+
+            for (i = 0; i < 2; ++i) {
+                double times[NUMBER_OF_MIXES];
+
+                if (!MeasureMixes(items, numberOfNodes, arity, i == 0 ? &SystemAllocator
+                                                                      : &AlignedSystemAllocator
+                                  , times)) {
+                    fprintf(stderr, "out of memory\n");
+                    return 1;
+                }
+
+                printf("%10d %6d %9s", numberOfNodes, arity, i == 0 ? "system" : "aligned");
+                int j;
+
+                for (j = 0; j < NUMBER_OF_MIXES; ++j) {
+                    printf(" %10.1f", times[j]);
+                }
+
+                putchar('\n');
+            }
+        }
+    }
+
+    free(items);
+    return 0;
+}
+
+
+static bool
+MeasureMixes(struct Item *items, int numberOfNodes, int arity
+             , struct Allocator *segmentAllocator, double *times)
+{
+    int i;
+
+    for (i = 0; i < NUMBER_OF_MIXES; ++i) {
+        times[i] = -1.0;
+    }
+
+    for (i = 0; i < NUMBER_OF_RUNS; ++i) {
+        struct Heap heap;
+        Heap_Initialize(&heap);
+        Heap_SetArity(&heap, arity);
+        Heap_SetSegmentAllocator(&heap, segmentAllocator);
+        uint64_t randomState = 1;
+        double mixTimes[NUMBER_OF_MIXES];
+        int j;
+
+        mixTimes[0] = GetTime();
+
+        if (!FillHeap(&heap, items, numberOfNodes, &randomState)) {
+            return false;
+        }
+
+        mixTimes[0] = (GetTime() - mixTimes[0]) / numberOfNodes;
+        mixTimes[1] = GetTime();
+
+        for (j = 0; j < NUMBER_OF_OPERATIONS; ++j) {
+            struct HeapNode *node = Heap_PopTop(&heap, CompareItems);
+            CONTAINER_OF(node, struct Item, heapNode)->key += DrawRandomNumber(&randomState)
+                                                              % numberOfNodes;
+            Heap_InsertNode(&heap, node, CompareItems);
+        }
+
+        mixTimes[1] = (GetTime() - mixTimes[1]) / NUMBER_OF_OPERATIONS;
+        mixTimes[2] = GetTime();
+
+        for (j = 0; j < NUMBER_OF_OPERATIONS; ++j) {
+            struct Item *item = &items[DrawRandomNumber(&randomState) % numberOfNodes];
+            item->key = DrawRandomNumber(&randomState);
+            Heap_AdjustNode(&heap, &item->heapNode, CompareItems);
+        }
+
+        mixTimes[2] = (GetTime() - mixTimes[2]) / NUMBER_OF_OPERATIONS;
+        mixTimes[3] = GetTime();
+
+        for (j = 0; j < NUMBER_OF_OPERATIONS; ++j) {
+            struct Item *item = &items[DrawRandomNumber(&randomState) % numberOfNodes];
+            Heap_RemoveNode(&heap, &item->heapNode, CompareItems);
+            item->key = DrawRandomNumber(&randomState);
+            Heap_InsertNode(&heap, &item->heapNode, CompareItems);
+        }
+
+        mixTimes[3] = (GetTime() - mixTimes[3]) / NUMBER_OF_OPERATIONS;
+        Heap_Finalize(&heap);
+
+        for (j = 0; j < NUMBER_OF_MIXES; ++j) {
+            if (times[j] < 0.0 || mixTimes[j] * 1e9 < times[j]) {
+                times[j] = mixTimes[j] * 1e9;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+static bool
+FillHeap(struct Heap *heap, struct Item *items, int numberOfNodes, uint64_t *randomState)
+{
+    int i;
+
+    for (i = 0; i < numberOfNodes; ++i) {
+        items[i].key = DrawRandomNumber(randomState);
+
+        if (!Heap_InsertNode(heap, &items[i].heapNode, CompareItems)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+static int
+CompareItems(const struct HeapNode *node1, const struct HeapNode *node2)
+{
+    uint64_t key1 = CONTAINER_OF(node1, struct Item, heapNode)->key;
+    uint64_t key2 = CONTAINER_OF(node2, struct Item, heapNode)->key;
+    return (key1 > key2) - (key1 < key2);
+}
+
+
+static uint64_t
+DrawRandomNumber(uint64_t *randomState)
+{
+    *randomState ^= *randomState << 13;
+    *randomState ^= *randomState >> 7;
+    *randomState ^= *randomState << 17;
+    return *randomState;
+}
+
+
+static double
+GetTime(void)
+{
+    struct timespec timespec;
+    clock_gettime(CLOCK_MONOTONIC, &timespec);
+    return timespec.tv_sec + timespec.tv_nsec / 1e9;
+}
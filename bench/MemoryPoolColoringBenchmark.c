@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+/*
+ * Measures the cost of a strided traversal, which visits the block of the same index in each of
+ * a number of chunks, with chunk coloring and with `MemoryPool_DisableChunkColoring`:
+ *
+ *     cc -std=gnu11 -O2 -DNDEBUG -I.. -o MemoryPoolColoringBenchmark \
+ *        MemoryPoolColoringBenchmark.c ../MemoryPool.c ../MemoryChunkProvider.c \
+ *        ../AllocationProfiler.c -lpthread -lm
+ *     ./MemoryPoolColoringBenchmark [<block size> [<max number of chunks>]]
+ *
+ * The visited blocks are chained, so each visit waits for the previous one and costs a full
+ * cache hit or miss. Without coloring, they all lie at the same offset in chunks aligned to the
+ * chunk size, hence map to the same cache set and conflict once they outnumber its ways.
+ *
+ * Times are the best of a few runs, in nanoseconds per visit.
+ */
+
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "MemoryPool.h"
+
+
+#define NUMBER_OF_RUNS 3
+#define NUMBER_OF_VISITS (1 << 24)
+
+
+static double MeasureTraversal(size_t, int, bool, int *);
+static double GetTime(void);
+
+
+int
+main(int argc, char **argv)
+{
+    size_t blockSize = argc >= 2 ? (size_t)atol(argv[1]) : 1000;
+    int maxNumberOfChunks = argc >= 3 ? atoi(argv[2]) : 256;
+
+    if (blockSize < sizeof(void *) || blockSize > MemoryChunkPayloadSize
+        || maxNumberOfChunks < 1) {
+        fprintf(stderr, "usage: %s [<block size> [<max number of chunks>]]\n", argv[0]);
+        return 1;
+    }
+
+    printf("%8s %8s %14s %14s\n", "chunks", "colors", "colored", "uncolored");
+    int numberOfChunks;
+
+    for (numberOfChunks = 2; numberOfChunks <= maxNumberOfChunks; numberOfChunks *= 2) {
+        int numberOfChunkColors;
+        double times[2];
+        int i;
+
+        for (i = 0; i < 2; ++i) {
+            times[i] = MeasureTraversal(blockSize, numberOfChunks, i == 0, &numberOfChunkColors);
+
+            if (times[i] < 0.0) {
+                fprintf(stderr, "out of memory\n");
+                return 1;
+            }
+
+            if (i == 0) {
+                printf("%8d %8d", numberOfChunks, numberOfChunkColors);
+            }
+        }
+
+        printf(" %14.2f %14.2f\n", times[0], times[1]);
+    }
+
+    return 0;
+}
+
+
+static double
+MeasureTraversal(size_t blockSize, int numberOfChunks, bool colorsChunks
+                 , int *numberOfChunkColors)
+{
+    struct MemoryPool pool;
+    MemoryPool_Initialize(&pool, blockSize);
+
+    if (!colorsChunks) {
+        MemoryPool_DisableChunkColoring(&pool);
+    }
+
+    *numberOfChunkColors = pool.numberOfChunkColors;
+    struct MemoryPoolStatistics statistics;
+    MemoryPool_GetStatistics(&pool, &statistics);
+    int numberOfBlocks = numberOfChunks * statistics.numberOfSlotsPerChunk;
+    void **blocks = malloc(numberOfBlocks * sizeof *blocks);
+
+    if (blocks == NULL || !MemoryPool_AllocateBlocks(&pool, numberOfBlocks, blocks)) {
+        free(blocks);
+        MemoryPool_Finalize(&pool);
+        return -1.0;
+    }
+
+    /*
+     * Chunks are filled one at a time, so the first block of each chunk is found at a multiple
+     * of the number of slots per chunk. These blocks are chained into a ring.
+     */
+    int i;
+
+    for (i = 0; i < numberOfChunks; ++i) {
+        *(void **)blocks[i * statistics.numberOfSlotsPerChunk]
+            = blocks[(i + 1) % numberOfChunks * statistics.numberOfSlotsPerChunk];
+    }
+
+    double bestTime = -1.0;
+
+    for (i = 0; i < NUMBER_OF_RUNS; ++i) {
+        void *volatile *block = blocks[0];
+        double time = GetTime();
+        int j;
+
+        for (j = 0; j < NUMBER_OF_VISITS; ++j) {
+            block = *block;
+        }
+
+        time = (GetTime() - time) * 1e9 / NUMBER_OF_VISITS;
+
+        if (bestTime < 0.0 || time < bestTime) {
+            bestTime = time;
+        }
+    }
+
+    MemoryPool_FreeBlocks(&pool, numberOfBlocks, blocks);
+    free(blocks);
+    MemoryPool_Finalize(&pool);
+    return bestTime;
+}
+
+
+static double
+GetTime(void)
+{
+    struct timespec timespec;
+    clock_gettime(CLOCK_MONOTONIC, &timespec);
+    return timespec.tv_sec + timespec.tv_nsec / 1e9;
+}
@@ -0,0 +1,362 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+/*
+ * Measures the throughput of `struct MultiQueue` against a heap under a mutex, for 1, 2, 4, ...
+ * threads, and the rank error of its pops:
+ *
+ *     cc -std=gnu11 -O2 -DNDEBUG -I.. -o MultiQueueBenchmark MultiQueueBenchmark.c \
+ *        ../MultiQueue.c ../Heap.c ../Vector.c ../Allocator.c -lpthread
+ *     ./MultiQueueBenchmark [<max number of threads> [<number of shards per thread>]]
+ *
+ * Threads run the hold model: each pops a node and pushes it back with a later key, which keeps
+ * the size of the queue constant. The rank of a popped node is the number of nodes in the queue
+ * with smaller keys, counted with a Fenwick tree kept alongside the queue, and is only
+ * approximate under concurrency. Run with no more threads than processors, lest ranks measure
+ * shards held by descheduled threads instead.
+ */
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "MultiQueue.h"
+
+
+#define QUEUE_SIZE (1 << 16)
+#define NUMBER_OF_OPERATIONS_PER_THREAD (1 << 20)
+#define KEY_INCREMENT_RANGE (1 << 16)
+#define KEY_SPACE_WIDTH 24
+#define KEY_SPACE_SIZE (1 << KEY_SPACE_WIDTH)
+#define NUMBER_OF_RANK_BUCKETS 24
+
+
+struct Item
+{
+    uint64_t key;
+    struct HeapNode heapNode;
+};
+
+
+struct LockedHeap
+{
+    pthread_mutex_t mutex;
+    struct Heap heap;
+};
+
+
+struct Run
+{
+    struct MultiQueue *multiQueue;
+    struct LockedHeap *lockedHeap;
+    bool measuresRanks;
+    pthread_barrier_t barrier;
+};
+
+
+struct Worker
+{
+    struct Run *run;
+    uint64_t randomState;
+    long rankCounts[NUMBER_OF_RANK_BUCKETS];
+    long long rankSum;
+    long maxRank;
+    long numberOfRankSamples;
+};
+
+
+static double RunWorkers(struct Run *, struct Worker *, int);
+static void *Work(void *);
+static void PrintRanks(const struct Worker *, int, int);
+
+static int CompareItems(const struct HeapNode *, const struct HeapNode *);
+static void AddKey(uint64_t, int);
+static long CountSmallerKeys(uint64_t);
+static uint64_t DrawRandomNumber(uint64_t *);
+static double GetTime(void);
+
+
+static atomic_int KeyCounts[KEY_SPACE_SIZE + 1];
+
+
+int
+main(int argc, char **argv)
+{
+    int maxNumberOfThreads = argc >= 2 ? atoi(argv[1]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int numberOfShardsPerThread = argc >= 3 ? atoi(argv[2]) : 2;
+
+    if (maxNumberOfThreads < 1 || numberOfShardsPerThread < 1) {
+        fprintf(stderr, "usage: %s [<max number of threads> [<number of shards per thread>]]\n"
+                , argv[0]);
+        return 1;
+    }
+
+    static struct Item items[QUEUE_SIZE];
+    struct Worker *workers = calloc(maxNumberOfThreads, sizeof *workers);
+
+    if (workers == NULL) {
+        return 1;
+    }
+
+    printf("%8s %8s %16s %16s %12s %12s\n", "threads", "shards", "multi-queue Mop/s"
+           , "locked-heap Mop/s", "mean rank", "max rank");
+    int numberOfThreads;
+
+    for (numberOfThreads = 1; numberOfThreads <= maxNumberOfThreads; numberOfThreads *= 2) {
+        int numberOfShards = numberOfShardsPerThread * numberOfThreads;
+        double throughputs[2];
+        int i;
+
+        for (i = 0; i < 3; ++i) {
+            struct MultiQueue multiQueue;
+            struct LockedHeap lockedHeap;
+            struct Run run = {.measuresRanks = i == 2};
+            uint64_t randomState = 1;
+            int j;
+
+            if (i == 1) {
+                pthread_mutex_init(&lockedHeap.mutex, NULL);
+                Heap_Initialize(&lockedHeap.heap);
+                run.lockedHeap = &lockedHeap;
+            } else if (!MultiQueue_Initialize(&multiQueue, numberOfShards)) {
+                return 1;
+            } else {
+                run.multiQueue = &multiQueue;
+            }
+
+            for (j = 0; j < QUEUE_SIZE; ++j) {
+                items[j].key = DrawRandomNumber(&randomState) % KEY_INCREMENT_RANGE;
+                bool nodeIsInserted = run.multiQueue != NULL
+                                      ? MultiQueue_Push(run.multiQueue, &items[j].heapNode
+                                                        , CompareItems)
+                                      : Heap_InsertNode(&run.lockedHeap->heap
+                                                        , &items[j].heapNode, CompareItems);
+
+                if (!nodeIsInserted) {
+                    return 1;
+                }
+
+                if (run.measuresRanks) {
+                    AddKey(items[j].key, 1);
+                }
+            }
+
+            double time = RunWorkers(&run, workers, numberOfThreads);
+
+            if (i < 2) {
+                throughputs[i] = numberOfThreads * (double)NUMBER_OF_OPERATIONS_PER_THREAD
+                                 / time / 1e6;
+            } else {
+                PrintRanks(workers, numberOfThreads, numberOfShards);
+            }
+
+            if (i == 1) {
+                Heap_Finalize(&lockedHeap.heap);
+                pthread_mutex_destroy(&lockedHeap.mutex);
+            } else {
+                MultiQueue_Finalize(&multiQueue);
+            }
+
+            if (run.measuresRanks) {
+                for (j = 0; j <= KEY_SPACE_SIZE; ++j) {
+                    atomic_store_explicit(&KeyCounts[j], 0, memory_order_relaxed);
+                }
+            }
+
+            if (i == 1) {
+                printf("%8d %8d %16.2f %16.2f", numberOfThreads, numberOfShards, throughputs[0]
+                       , throughputs[1]);
+            }
+        }
+    }
+
+    free(workers);
+    return 0;
+}
+
+
+static double
+RunWorkers(struct Run *run, struct Worker *workers, int numberOfThreads)
+{
+    pthread_t threads[numberOfThreads];
+    pthread_barrier_init(&run->barrier, NULL, numberOfThreads + 1);
+    int i;
+
+    for (i = 0; i < numberOfThreads; ++i) {
+        workers[i] = (struct Worker) {.run = run, .randomState = 2 * i + 3};
+
+        if (pthread_create(&threads[i], NULL, Work, &workers[i]) != 0) {
+            exit(1);
+        }
+    }
+
+    pthread_barrier_wait(&run->barrier);
+    double time = GetTime();
+
+    for (i = 0; i < numberOfThreads; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    time = GetTime() - time;
+    pthread_barrier_destroy(&run->barrier);
+    return time;
+}
+
+
+static void *
+Work(void *argument)
+{
+    struct Worker *self = argument;
+    struct Run *run = self->run;
+    pthread_barrier_wait(&run->barrier);
+    int i;
+
+    for (i = 0; i < NUMBER_OF_OPERATIONS_PER_THREAD; ++i) {
+        struct HeapNode *node;
+
+        if (run->multiQueue != NULL) {
+            node = MultiQueue_Pop(run->multiQueue, CompareItems);
+        } else {
+            pthread_mutex_lock(&run->lockedHeap->mutex);
+            node = Heap_PopTop(&run->lockedHeap->heap, CompareItems);
+            pthread_mutex_unlock(&run->lockedHeap->mutex);
+        }
+
+        struct Item *item = CONTAINER_OF(node, struct Item, heapNode);
+
+        if (run->measuresRanks) {
+            AddKey(item->key, -1);
+            long rank = CountSmallerKeys(item->key);
+
+            if (rank < 0) {
+                rank = 0;
+            }
+
+            ++self->rankCounts[rank == 0 ? 0 : 64 - __builtin_clzll(rank)];
+            self->rankSum += rank;
+            self->numberOfRankSamples += 1;
+
+            if (rank > self->maxRank) {
+                self->maxRank = rank;
+            }
+        }
+
+        item->key += DrawRandomNumber(&self->randomState) % KEY_INCREMENT_RANGE + 1;
+
+        if (item->key >= KEY_SPACE_SIZE) {
+            fprintf(stderr, "key space exhausted\n");
+            exit(1);
+        }
+
+        if (run->measuresRanks) {
+            AddKey(item->key, 1);
+        }
+
+        if (run->multiQueue != NULL) {
+            MultiQueue_Push(run->multiQueue, node, CompareItems);
+        } else {
+            pthread_mutex_lock(&run->lockedHeap->mutex);
+            Heap_InsertNode(&run->lockedHeap->heap, node, CompareItems);
+            pthread_mutex_unlock(&run->lockedHeap->mutex);
+        }
+    }
+
+    return NULL;
+}
+
+
+static void
+PrintRanks(const struct Worker *workers, int numberOfThreads, int numberOfShards)
+{
+    long rankCounts[NUMBER_OF_RANK_BUCKETS] = {0};
+    long long rankSum = 0;
+    long maxRank = 0;
+    long numberOfRankSamples = 0;
+    int i;
+
+    for (i = 0; i < numberOfThreads; ++i) {
+        int j;
+
+        for (j = 0; j < NUMBER_OF_RANK_BUCKETS; ++j) {
+            rankCounts[j] += workers[i].rankCounts[j];
+        }
+
+        rankSum += workers[i].rankSum;
+        numberOfRankSamples += workers[i].numberOfRankSamples;
+
+        if (workers[i].maxRank > maxRank) {
+            maxRank = workers[i].maxRank;
+        }
+    }
+
+    printf(" %12.2f %12ld\n", (double)rankSum / numberOfRankSamples, maxRank);
+    printf("%8s rank histogram (%d shards):", "", numberOfShards);
+
+    for (i = 0; i < NUMBER_OF_RANK_BUCKETS && rankCounts[i] >= 1; ++i) {
+        printf(" [%ld, %ld] %.3f%%", i == 0 ? 0 : 1L << (i - 1), i == 0 ? 0 : (1L << i) - 1
+               , 100.0 * rankCounts[i] / numberOfRankSamples);
+    }
+
+    putchar('\n');
+}
+
+
+static int
+CompareItems(const struct HeapNode *node1, const struct HeapNode *node2)
+{
+    uint64_t key1 = CONTAINER_OF(node1, struct Item, heapNode)->key;
+    uint64_t key2 = CONTAINER_OF(node2, struct Item, heapNode)->key;
+    return (key1 > key2) - (key1 < key2);
+}
+
+
+static void
+AddKey(uint64_t key, int delta)
+{
+    uint64_t i;
+
+    for (i = key + 1; i <= KEY_SPACE_SIZE; i += i & -i) {
+        atomic_fetch_add_explicit(&KeyCounts[i], delta, memory_order_relaxed);
+    }
+}
+
+
+static long
+CountSmallerKeys(uint64_t key)
+{
+    long count = 0;
+    uint64_t i;
+
+    for (i = key; i >= 1; i -= i & -i) {
+        count += atomic_load_explicit(&KeyCounts[i], memory_order_relaxed);
+    }
+
+    return count;
+}
+
+
+static uint64_t
+DrawRandomNumber(uint64_t *randomState)
+{
+    *randomState ^= *randomState << 13;
+    *randomState ^= *randomState >> 7;
+    *randomState ^= *randomState << 17;
+    return *randomState;
+}
+
+
+static double
+GetTime(void)
+{
+    struct timespec timespec;
+    clock_gettime(CLOCK_MONOTONIC, &timespec);
+    return timespec.tv_sec + timespec.tv_nsec / 1e9;
+}
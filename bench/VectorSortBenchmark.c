@@ -0,0 +1,210 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+/*
+ * Measures `Vector_Sort` (on one thread and on many) and `Vector_SortByKey` (on 4- and 8-byte
+ * keys) against qsort(3), sorting 16-byte key/pointer records of random keys, as the number of
+ * records grows:
+ *
+ *     cc -std=gnu11 -O2 -DNDEBUG -I.. -o VectorSortBenchmark VectorSortBenchmark.c ../Vector.c \
+ *        ../Allocator.c -lpthread
+ *     ./VectorSortBenchmark [<max number of records> [<number of threads>]]
+ *
+ * Times are the best of a few runs, in nanoseconds per record.
+ */
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "Vector.h"
+
+
+#define NUMBER_OF_RUNS 3
+
+
+struct Record
+{
+    uint64_t key;
+    void *pointer;
+};
+
+
+static double MeasureSort(struct Vector *, const struct Record *, ptrdiff_t, int, int);
+static bool CheckOrder(const struct Vector *);
+
+static int CompareRecords(const void *, const void *);
+static uint64_t ExtractKey(const void *);
+static uint64_t DrawRandomNumber(uint64_t *);
+static double GetTime(void);
+
+
+int
+main(int argc, char **argv)
+{
+    ptrdiff_t maxNumberOfRecords = argc >= 2 ? atol(argv[1]) : 1 << 22;
+    int numberOfThreads = argc >= 3 ? atoi(argv[2]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (maxNumberOfRecords < 1 || numberOfThreads < 1) {
+        fprintf(stderr, "usage: %s [<max number of records> [<number of threads>]]\n", argv[0]);
+        return 1;
+    }
+
+    struct Record *records = malloc(maxNumberOfRecords * sizeof *records);
+
+    if (records == NULL) {
+        return 1;
+    }
+
+    uint64_t randomState = 1;
+    ptrdiff_t i;
+
+    for (i = 0; i < maxNumberOfRecords; ++i) {
+        records[i].key = DrawRandomNumber(&randomState);
+        records[i].pointer = &records[i];
+    }
+
+    struct Vector vector;
+    Vector_Initialize(&vector, sizeof(struct Record));
+    printf("%10s %10s %14s %14s %14s %14s\n", "records", "qsort", "Sort/1 thread"
+           , "Sort/threads", "SortByKey/4", "SortByKey/8");
+    ptrdiff_t numberOfRecords;
+
+    for (numberOfRecords = 1 << 10; numberOfRecords <= maxNumberOfRecords
+         ; numberOfRecords *= 4) {
+        printf("%10td", numberOfRecords);
+        int j;
+
+        for (j = 0; j < 5; ++j) {
+            static const int sortThreadCounts[5] = {0, 1, -1, 0, 0};
+            static const int keySizes[5] = {0, 0, 0, 4, 8};
+            int sortThreadCount = sortThreadCounts[j] < 0 ? numberOfThreads
+                                                           : sortThreadCounts[j];
+            double time = MeasureSort(&vector, records, numberOfRecords, sortThreadCount
+                                      , keySizes[j]);
+
+            if (time < 0.0) {
+                fprintf(stderr, "sort failed\n");
+                return 1;
+            }
+
+            printf(" %*.1f", j == 0 ? 10 : 14, time * 1e9 / numberOfRecords);
+        }
+
+        putchar('\n');
+    }
+
+    Vector_Finalize(&vector);
+    free(records);
+    return 0;
+}
+
+
+static double
+MeasureSort(struct Vector *vector, const struct Record *records, ptrdiff_t numberOfRecords
+            , int numberOfThreads, int keySize)
+{
+    double bestTime = -1.0;
+    int i;
+
+    for (i = 0; i < NUMBER_OF_RUNS; ++i) {
+        if (!Vector_SetLength(vector, 0, false)
+            || !Vector_Append(vector, records, numberOfRecords)) {
+            return -1.0;
+        }
+
+        struct Record *elements = Vector_GetElements(vector);
+        ptrdiff_t j;
+
+        /*
+         * 4-byte keys are sorted with the high halves of the keys cleared.
+         */
+        if (keySize == 4) {
+            for (j = 0; j < numberOfRecords; ++j) {
+                elements[j].key &= UINT32_MAX;
+            }
+        }
+
+        double time = GetTime();
+        bool isSorted;
+
+        if (keySize >= 1) {
+            isSorted = Vector_SortByKey(vector, ExtractKey, keySize);
+        } else if (numberOfThreads >= 1) {
+            isSorted = Vector_Sort(vector, CompareRecords, numberOfThreads);
+        } else {
+            qsort(elements, numberOfRecords, sizeof *elements, CompareRecords);
+            isSorted = true;
+        }
+
+        time = GetTime() - time;
+
+        if (!isSorted || !CheckOrder(vector)) {
+            return -1.0;
+        }
+
+        if (bestTime < 0.0 || time < bestTime) {
+            bestTime = time;
+        }
+    }
+
+    return bestTime;
+}
+
+
+static bool
+CheckOrder(const struct Vector *vector)
+{
+    const struct Record *elements = Vector_GetElements(vector);
+    ptrdiff_t i;
+
+    for (i = 1; i < Vector_GetLength(vector); ++i) {
+        if (elements[i - 1].key > elements[i].key) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+static int
+CompareRecords(const void *record1, const void *record2)
+{
+    uint64_t key1 = ((const struct Record *)record1)->key;
+    uint64_t key2 = ((const struct Record *)record2)->key;
+    return (key1 > key2) - (key1 < key2);
+}
+
+
+static uint64_t
+ExtractKey(const void *record)
+{
+    return ((const struct Record *)record)->key;
+}
+
+
+static uint64_t
+DrawRandomNumber(uint64_t *randomState)
+{
+    *randomState ^= *randomState << 13;
+    *randomState ^= *randomState >> 7;
+    *randomState ^= *randomState << 17;
+    return *randomState;
+}
+
+
+static double
+GetTime(void)
+{
+    struct timespec timespec;
+    clock_gettime(CLOCK_MONOTONIC, &timespec);
+    return timespec.tv_sec + timespec.tv_nsec / 1e9;
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2015 Roy O'Young <roy2220@outlook.com>.
+ */
+
+
+/*
+ * Checks corner cases of `struct Vector`, aborting on the first failure:
+ *
+ *     cc -std=gnu11 -I.. -o VectorTest VectorTest.c ../Vector.c ../Allocator.c -lpthread
+ *     ./VectorTest
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "Vector.h"
+
+
+#define CHECK(condition)                                                    \
+    do {                                                                    \
+        if (!(condition)) {                                                 \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__ \
+                    , #condition);                                          \
+            abort();                                                        \
+        }                                                                   \
+    } while (0)
+
+
+static void TestShrinkingToNothing(size_t);
+static void TestShrinkingSmallVectorToNothing(void);
+
+
+int
+main(void)
+{
+    TestShrinkingToNothing(VECTOR_DEFAULT_MAPPING_THRESHOLD);
+    TestShrinkingToNothing(0);
+    TestShrinkingSmallVectorToNothing();
+    puts("ok");
+    return 0;
+}
+
+
+static void
+TestShrinkingToNothing(size_t mappingThreshold)
+{
+    struct Vector vector;
+    Vector_Initialize(&vector, sizeof(long));
+    Vector_SetMappingThreshold(&vector, mappingThreshold, false);
+    long i;
+
+    for (i = 0; i < 100; ++i) {
+        CHECK(Vector_PushBack(&vector, &i));
+    }
+
+    CHECK(Vector_SetLength(&vector, 0, false));
+    CHECK(Vector_GetElements(&vector) == NULL);
+    CHECK(Vector_GetCapacity(&vector) == 0);
+
+    for (i = 0; i < 1000; ++i) {
+        CHECK(Vector_PushBack(&vector, &i));
+    }
+
+    long *elements = Vector_GetElements(&vector);
+
+    for (i = 0; i < 1000; ++i) {
+        CHECK(elements[i] == i);
+    }
+
+    Vector_Finalize(&vector);
+}
+
+
+static void
+TestShrinkingSmallVectorToNothing(void)
+{
+    SMALL_VECTOR(long, 4) smallVector;
+    SMALL_VECTOR_INITIALIZE(&smallVector);
+    long i;
+
+    for (i = 0; i < 100; ++i) {
+        CHECK(Vector_PushBack(&smallVector.vector, &i));
+    }
+
+    CHECK(Vector_SetLength(&smallVector.vector, 0, false));
+    CHECK(Vector_GetElements(&smallVector.vector) == smallVector.inlineElements);
+    CHECK(Vector_GetCapacity(&smallVector.vector) == 4);
+    Vector_Finalize(&smallVector.vector);
+}